@@ -1,5 +1,10 @@
 #include <sequence/parser/Browser.h>
+#include <sequence/parser/NaturalSort.h>
+#include <sequence/parser/PathList.h>
+#include <sequence/parser/Statistics.h>
+#include <sequence/parser/Walker.h>
 #include <sequence/DisplayUtils.h>
+#include <sequence/ItemWriter.h>
 
 #include <boost/chrono/chrono.hpp>
 #include <boost/chrono/chrono_io.hpp>
@@ -15,7 +20,8 @@ using namespace boost::chrono;
 
 void printUsage( const char* prgName )
 {
-	printf( "USAGE: %s [-R] [PATH]\n", prgName );
+	printf( "USAGE: %s [-R] [-L] [--sort] [--latest PREFIX] [--stats] [--format plain|json|nul] PATH\n"
+			"       %s [--sort] [--stats] [--format plain|json|nul] --from-list FILE|-\n", prgName, prgName );
 	exit( EXIT_FAILURE );
 }
 
@@ -23,31 +29,84 @@ int main( int argc, char **argv )
 {
 	try
 	{
-		if( argc > 3 || argc == 1 )
+		if( argc == 1 )
 			printUsage( argv[0] );
 
-		bool recursive = false;
-		if( argc == 3 )
+		sequence::parser::BrowseOptions options;
+		sequence::parser::Statistics statistics;
+		const char* path = NULL;
+		const char* list = NULL;
+		sequence::OutputFormat format = sequence::FORMAT_PLAIN;
+		for( int i = 1; i < argc; ++i )
 		{
-			if( string( argv[1] ) == "-R" )
+			const string arg( argv[i] );
+			if( arg == "-R" )
+				options.recursive = true;
+			else if( arg == "-L" )
+				options.followSymlinks = true;
+			else if( arg == "--sort" )
+				options.sorted = true;
+			else if( arg == "--latest" && i + 1 < argc )
+				options.versionPrefix = argv[++i];
+			else if( arg == "--stats" )
+				options.statistics = &statistics;
+			else if( arg == "--from-list" && i + 1 < argc )
+				list = argv[++i];
+			else if( arg == "--format" && i + 1 < argc )
 			{
-				recursive = true;
+				const string value( argv[++i] );
+				if( value == "plain" )
+					format = sequence::FORMAT_PLAIN;
+				else if( value == "json" )
+					format = sequence::FORMAT_JSON;
+				else if( value == "nul" )
+					format = sequence::FORMAT_NUL;
+				else
+					printUsage( argv[0] );
 			}
+			else if( i == argc - 1 && !list )
+				path = argv[i];
 			else
-			{
 				printUsage( argv[0] );
-			}
 		}
+		if( ( !path && !list ) || ( list && !options.versionPrefix.empty() ) )
+			printUsage( argv[0] );
+
+		sequence::ItemWriter writer( stdout, format );
+		if( format != sequence::FORMAT_PLAIN && !list )
+		{
+			// machine readable output is streamed directory by directory
+			sequence::parser::Walker walker( path, options );
+			sequence::BrowseItems items;
+			while( walker.next( items ) )
+				writer.write( items.begin(), items.end() );
+		}
+		else
+		{
+			high_resolution_clock::time_point start = high_resolution_clock::now();
 
-		high_resolution_clock::time_point start = high_resolution_clock::now();
+			typedef vector<sequence::BrowseItem> Items;
+			Items items = list ?
+					sequence::parser::parseList( list, 0, options.statistics ) :
+					sequence::parser::browse( path, options );
+			if( list && options.sorted )
+				sequence::parser::sortItems( items );
 
-		typedef vector<sequence::BrowseItem> Items;
-		const Items items = sequence::parser::browse( argv[ argc == 3 ? 2 : 1 ], recursive );
+			if( format == sequence::FORMAT_PLAIN )
+			{
+				ostringstream stream;
+				stream << "Listing " << items.size() << " items took " << duration_cast<milliseconds>( high_resolution_clock::now() - start ) << endl;
+				fputs( stream.str().c_str(), stdout );
+			}
+			writer.write( items.begin(), items.end() );
+			writer.flush();
+			if( format == sequence::FORMAT_PLAIN )
+				fputc( '\n', stdout );
+		}
+		writer.flush();
 
-		ostringstream stream;
-		stream << "Listing " << items.size() << " items took " << duration_cast<milliseconds>( high_resolution_clock::now() - start ) << endl;
-		copy( items.begin(), items.end(), ostream_iterator<sequence::BrowseItem>( stream, "\n" ) );
-		printf( "%s\n", stream.str().c_str() );
+		if( options.statistics )
+			cerr << statistics;
 
 		return EXIT_SUCCESS;
 	}
@@ -0,0 +1,82 @@
+#include <sequence/parser/Daemon.h>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+#ifdef SEQUENCEPARSER_HAS_DAEMON
+#include <signal.h>
+#endif
+
+using namespace std;
+
+#ifndef SEQUENCEPARSER_HAS_DAEMON
+
+int main( int, char **argv )
+{
+	cerr << argv[0] << " needs Unix domain sockets, not available on this platform" << endl;
+	return EXIT_FAILURE;
+}
+
+#else
+
+void printUsage( const char* prgName )
+{
+	printf( "USAGE: %s [--socket PATH] [--threads N]\n"
+			"Serves sequence::parser::DaemonClient requests until interrupted.\n"
+			"The socket defaults to $LSSD_SOCKET or /tmp/lssd-<uid>.sock\n", prgName );
+	exit( EXIT_FAILURE );
+}
+
+int main( int argc, char **argv )
+{
+	try
+	{
+		string socketPath = sequence::parser::defaultSocketPath();
+		size_t threads = 0;
+		for( int i = 1; i < argc; ++i )
+		{
+			const string arg( argv[i] );
+			if( arg == "--socket" && i + 1 < argc )
+				socketPath = argv[++i];
+			else if( arg == "--threads" && i + 1 < argc )
+				threads = boost::lexical_cast<size_t>( argv[++i] );
+			else
+				printUsage( argv[0] );
+		}
+
+		// the signals are waited for by the main thread, the server threads inherit the mask
+		sigset_t signals;
+		sigemptyset( &signals );
+		sigaddset( &signals, SIGINT );
+		sigaddset( &signals, SIGTERM );
+		sigaddset( &signals, SIGHUP );
+		pthread_sigmask( SIG_BLOCK, &signals, NULL );
+		signal( SIGPIPE, SIG_IGN );
+
+		sequence::parser::DaemonServer server( socketPath );
+		boost::thread serving( boost::bind( &sequence::parser::DaemonServer::run, &server, threads ) );
+		cerr << "lssd listening on " << socketPath << endl;
+		int received;
+		sigwait( &signals, &received );
+		server.stop();
+		serving.join();
+
+		const sequence::parser::DaemonCounters counters = server.counters();
+		cerr << "lssd served " << counters.requests << " requests, "
+			 << counters.hits << " directories from the cache and "
+			 << counters.misses << " from disk" << endl;
+	}
+	catch( std::exception &e )
+	{
+		cerr << e.what() << endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+#endif
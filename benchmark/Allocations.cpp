@@ -0,0 +1,78 @@
+#include "Allocations.h"
+
+#include <cstdlib>
+#include <new>
+
+// dynamic exception specifications are ill formed since C++17
+#if __cplusplus < 201103L
+#define SEQUENCE_THROWS_BAD_ALLOC throw( std::bad_alloc )
+#define SEQUENCE_NOTHROW throw()
+#else
+#define SEQUENCE_THROWS_BAD_ALLOC
+#define SEQUENCE_NOTHROW noexcept
+#endif
+
+namespace
+{
+
+size_t gCount = 0;
+size_t gBytes = 0;
+
+void* allocate( size_t size )
+{
+	__sync_fetch_and_add( &gCount, 1 );
+	__sync_fetch_and_add( &gBytes, size );
+	void *pointer = std::malloc( size ? size : 1 );
+	if( !pointer )
+		throw std::bad_alloc();
+	return pointer;
+}
+
+}
+
+void* operator new( size_t size ) SEQUENCE_THROWS_BAD_ALLOC
+{
+	return allocate( size );
+}
+
+void* operator new[]( size_t size ) SEQUENCE_THROWS_BAD_ALLOC
+{
+	return allocate( size );
+}
+
+void operator delete( void *pointer ) SEQUENCE_NOTHROW
+{
+	std::free( pointer );
+}
+
+void operator delete[]( void *pointer ) SEQUENCE_NOTHROW
+{
+	std::free( pointer );
+}
+
+#ifdef __cpp_sized_deallocation
+void operator delete( void *pointer, size_t ) noexcept
+{
+	std::free( pointer );
+}
+
+void operator delete[]( void *pointer, size_t ) noexcept
+{
+	std::free( pointer );
+}
+#endif
+
+namespace bench
+{
+
+size_t allocationCount()
+{
+	return __sync_fetch_and_add( &gCount, 0 );
+}
+
+size_t allocatedBytes()
+{
+	return __sync_fetch_and_add( &gBytes, 0 );
+}
+
+}
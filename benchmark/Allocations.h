@@ -0,0 +1,27 @@
+/*
+ * Allocations.h
+ *
+ * Counts the heap allocations made by the benchmark executable.
+ */
+
+#ifndef ALLOCATIONS_H_
+#define ALLOCATIONS_H_
+
+#include <cstddef>
+
+namespace bench
+{
+
+/**
+ * Number of calls to the global operator new since the program started
+ */
+size_t allocationCount();
+
+/**
+ * Bytes requested from the global operator new since the program started
+ */
+size_t allocatedBytes();
+
+}
+
+#endif
@@ -0,0 +1,353 @@
+#include "Benchmark.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+using namespace boost::chrono;
+
+namespace bench
+{
+
+State::State( const TreeShape &shape, size_t maxIterations ) :
+	shape( shape ),
+	maxIterations( maxIterations ),
+	currentIteration( 0 ),
+	running( false ),
+	elapsed( Clock::duration::zero() ),
+	itemsProcessed( 0 )
+{
+}
+
+bool State::keepRunning()
+{
+	if( currentIteration == 0 && !running )
+		resumeTiming();
+	if( currentIteration < maxIterations )
+	{
+		++currentIteration;
+		return true;
+	}
+	pauseTiming();
+	return false;
+}
+
+void State::pauseTiming()
+{
+	if( !running )
+		return;
+	elapsed += Clock::now() - start;
+	running = false;
+}
+
+void State::resumeTiming()
+{
+	running = true;
+	start = Clock::now();
+}
+
+void State::counter( const string &name, double value )
+{
+	for( size_t i = 0; i < counters.size(); ++i )
+	{
+		if( counters[i].first == name )
+		{
+			counters[i].second = value;
+			return;
+		}
+	}
+	counters.push_back( make_pair( name, value ) );
+}
+
+struct Registered
+{
+	const char* name;
+	Function function;
+	bool perShape;
+};
+
+static vector<Registered>& registry()
+{
+	static vector<Registered> benchmarks;
+	return benchmarks;
+}
+
+Registrar::Registrar( const char* name, Function function, bool perShape )
+{
+	const Registered registered = { name, function, perShape };
+	registry().push_back( registered );
+}
+
+struct Result
+{
+	string benchmark;
+	string shape;
+	size_t iterations;
+	size_t repetitions;
+	double medianNs; ///< per iteration
+	double minNs;    ///< per iteration
+	double itemsPerSecond;
+	vector<pair<string, double> > counters;
+
+	string name() const
+	{
+		return shape.empty() ? benchmark : benchmark + '/' + shape;
+	}
+};
+
+struct Options
+{
+	Options() :
+		minTime( 0.2 ),
+		repetitions( 3 ),
+		scale( 1 )
+	{}
+
+	double minTime;
+	size_t repetitions;
+	double scale;
+	vector<string> filters;
+	vector<string> shapes;
+	string jsonFile;
+};
+
+class Runner
+{
+public:
+	Runner( const Options &options ) :
+		options( options )
+	{}
+
+	Result run( const Registered &registered, const TreeShape &shape ) const
+	{
+		// finding an iteration count running at least minTime
+		size_t iterations = 1;
+		for( ;; )
+		{
+			State state( shape, iterations );
+			registered.function( state );
+			const double seconds = duration_cast<duration<double> >( state.elapsed ).count();
+			if( seconds >= options.minTime || iterations >= 1000000000 )
+				break;
+			const double factor = seconds <= options.minTime / 100 ? 10 : 1.4 * options.minTime / seconds;
+			iterations = max( iterations + 1, static_cast<size_t>( iterations * factor ) );
+		}
+
+		Result result;
+		result.benchmark = registered.name;
+		result.shape = registered.perShape ? shape.name : "";
+		result.iterations = iterations;
+		result.repetitions = options.repetitions;
+		vector<double> perIteration;
+		const size_t repetitions = max( size_t( 1 ), options.repetitions );
+		for( size_t i = 0; i < repetitions; ++i )
+		{
+			State state( shape, iterations );
+			registered.function( state );
+			const double ns = duration_cast<duration<double, boost::nano> >( state.elapsed ).count();
+			perIteration.push_back( ns / iterations );
+			result.itemsPerSecond = state.itemsProcessed ? state.itemsProcessed / ( ns * 1e-9 ) : 0;
+			accumulate( result.counters, state.counters );
+		}
+		for( size_t c = 0; c < result.counters.size(); ++c )
+			result.counters[c].second /= repetitions;
+		sort( perIteration.begin(), perIteration.end() );
+		result.minNs = perIteration.front();
+		result.medianNs = perIteration[perIteration.size() / 2];
+		return result;
+	}
+
+private:
+	/**
+	 * Adds the counters of a repetition to the sums of the previous ones
+	 */
+	static void accumulate( vector<pair<string, double> > &sums, const vector<pair<string, double> > &counters )
+	{
+		for( size_t i = 0; i < counters.size(); ++i )
+		{
+			size_t c = 0;
+			while( c < sums.size() && sums[c].first != counters[i].first )
+				++c;
+			if( c == sums.size() )
+				sums.push_back( make_pair( counters[i].first, 0. ) );
+			sums[c].second += counters[i].second;
+		}
+	}
+
+	const Options &options;
+};
+
+static bool selected( const vector<string> &filters, const string &name )
+{
+	if( filters.empty() )
+		return true;
+	for( vector<string>::const_iterator itr = filters.begin(); itr != filters.end(); ++itr )
+		if( name.find( *itr ) != string::npos )
+			return true;
+	return false;
+}
+
+static string escape( const string &value )
+{
+	string result;
+	for( string::const_iterator itr = value.begin(); itr != value.end(); ++itr )
+	{
+		if( *itr == '"' || *itr == '\\' )
+			result.push_back( '\\' );
+		result.push_back( *itr );
+	}
+	return result;
+}
+
+static void writeJson( ostream &stream, const vector<Result> &results, const Options &options, const char* executable )
+{
+	char date[64];
+	const time_t now = time( NULL );
+	strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", localtime( &now ) );
+	stream << "{\n";
+	stream << "  \"context\": {\n";
+	stream << "    \"date\": \"" << date << "\",\n";
+	stream << "    \"executable\": \"" << escape( executable ) << "\",\n";
+	stream << "    \"min_time\": " << options.minTime << ",\n";
+	stream << "    \"scale\": " << options.scale << "\n";
+	stream << "  },\n";
+	stream << "  \"benchmarks\": [";
+	for( size_t i = 0; i < results.size(); ++i )
+	{
+		const Result &result = results[i];
+		stream << ( i ? "," : "" ) << "\n    {\n";
+		stream << "      \"name\": \"" << escape( result.name() ) << "\",\n";
+		stream << "      \"benchmark\": \"" << escape( result.benchmark ) << "\",\n";
+		stream << "      \"shape\": \"" << escape( result.shape ) << "\",\n";
+		stream << "      \"iterations\": " << result.iterations << ",\n";
+		stream << "      \"repetitions\": " << result.repetitions << ",\n";
+		stream << "      \"real_time\": " << result.medianNs << ",\n";
+		stream << "      \"min_time\": " << result.minNs << ",\n";
+		stream << "      \"time_unit\": \"ns\",\n";
+		stream << "      \"items_per_second\": " << result.itemsPerSecond;
+		for( size_t c = 0; c < result.counters.size(); ++c )
+			stream << ",\n      \"" << escape( result.counters[c].first ) << "\": " << result.counters[c].second;
+		stream << "\n    }";
+	}
+	stream << "\n  ]\n}\n";
+}
+
+static void printUsage( const char* prgName )
+{
+	printf( "USAGE: %s [--list] [--filter NAME]... [--shape NAME]... [--min-time SECONDS]\n"
+			"          [--repetitions N] [--scale FACTOR] [--json FILE|-]\n", prgName );
+	exit( EXIT_FAILURE );
+}
+
+static vector<TreeShape> selectShapes( const Options &options )
+{
+	vector<TreeShape> shapes;
+	const vector<TreeShape> all = defaultShapes();
+	for( vector<TreeShape>::const_iterator itr = all.begin(); itr != all.end(); ++itr )
+	{
+		if( !options.shapes.empty() && find( options.shapes.begin(), options.shapes.end(), itr->name ) == options.shapes.end() )
+			continue;
+		TreeShape shape = *itr;
+		shape.frames = max( size_t( 1 ), static_cast<size_t>( shape.frames * options.scale ) );
+		shapes.push_back( shape );
+	}
+	return shapes;
+}
+
+}
+
+using namespace bench;
+
+int main( int argc, char **argv )
+{
+	try
+	{
+		Options options;
+		bool list = false;
+		for( int i = 1; i < argc; ++i )
+		{
+			const string arg( argv[i] );
+			const bool hasValue = i + 1 < argc;
+			if( arg == "--list" )
+				list = true;
+			else if( arg == "--filter" && hasValue )
+				options.filters.push_back( argv[++i] );
+			else if( arg == "--shape" && hasValue )
+				options.shapes.push_back( argv[++i] );
+			else if( arg == "--min-time" && hasValue )
+				options.minTime = atof( argv[++i] );
+			else if( arg == "--repetitions" && hasValue )
+				options.repetitions = atoi( argv[++i] );
+			else if( arg == "--scale" && hasValue )
+				options.scale = atof( argv[++i] );
+			else if( arg == "--json" && hasValue )
+				options.jsonFile = argv[++i];
+			else
+				printUsage( argv[0] );
+		}
+
+		const vector<TreeShape> shapes = selectShapes( options );
+		const vector<Registered> &benchmarks = registry();
+		if( list )
+		{
+			for( vector<Registered>::const_iterator itr = benchmarks.begin(); itr != benchmarks.end(); ++itr )
+				printf( "%s%s\n", itr->name, itr->perShape ? " (per shape)" : "" );
+			for( vector<TreeShape>::const_iterator itr = shapes.begin(); itr != shapes.end(); ++itr )
+				printf( "shape %s : %lu folders, %lu files\n", itr->name.c_str(), static_cast<unsigned long>( itr->folders() ), static_cast<unsigned long>( itr->files() ) );
+			return EXIT_SUCCESS;
+		}
+
+		const Runner runner( options );
+		vector<Result> results;
+		// the table goes to stderr when the JSON report takes stdout
+		FILE* const table = options.jsonFile == "-" ? stderr : stdout;
+		fprintf( table, "%-40s %15s %15s %12s %15s\n", "Benchmark", "Time (ns)", "Min (ns)", "Iterations", "Items/s" );
+		for( vector<Registered>::const_iterator itr = benchmarks.begin(); itr != benchmarks.end(); ++itr )
+		{
+			const vector<TreeShape> runShapes = itr->perShape ? shapes : vector<TreeShape>( 1, TreeShape() );
+			for( vector<TreeShape>::const_iterator shape = runShapes.begin(); shape != runShapes.end(); ++shape )
+			{
+				const string name = itr->perShape ? string( itr->name ) + '/' + shape->name : itr->name;
+				if( !selected( options.filters, name ) )
+					continue;
+				results.push_back( runner.run( *itr, *shape ) );
+				const Result &result = results.back();
+				fprintf( table, "%-40s %15.0f %15.0f %12lu %15.0f\n", name.c_str(), result.medianNs, result.minNs,
+						 static_cast<unsigned long>( result.iterations ), result.itemsPerSecond );
+				for( size_t c = 0; c < result.counters.size(); ++c )
+					fprintf( table, "    %-36s %15g\n", result.counters[c].first.c_str(), result.counters[c].second );
+				fflush( table );
+			}
+		}
+
+		if( !options.jsonFile.empty() )
+		{
+			if( options.jsonFile == "-" )
+				writeJson( cout, results, options, argv[0] );
+			else
+			{
+				ofstream file( options.jsonFile.c_str() );
+				if( !file )
+					throw runtime_error( "Unable to write " + options.jsonFile );
+				writeJson( file, results, options, argv[0] );
+				if( !file.flush() )
+					throw runtime_error( "Unable to write " + options.jsonFile );
+			}
+		}
+		return EXIT_SUCCESS;
+	}
+	catch( exception& e )
+	{
+		cerr << "Unexpected error : " << e.what() << endl;
+	}
+	return EXIT_FAILURE;
+}
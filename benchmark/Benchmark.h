@@ -0,0 +1,107 @@
+/*
+ * Benchmark.h
+ *
+ * A minimal benchmarking harness : benchmarks register themselves with
+ * SEQUENCE_BENCHMARK and are run for each selected TreeShape.
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "TreeGenerator.h"
+
+#include <boost/chrono/chrono.hpp>
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace bench
+{
+
+typedef boost::chrono::high_resolution_clock Clock;
+
+/**
+ * Handed to a benchmark function, it drives the timed loop :
+ *
+ * SEQUENCE_BENCHMARK( Foo )
+ * {
+ *     setup();                     // not timed
+ *     while( state.keepRunning() ) // timed
+ *         foo();
+ *     state.setItemsProcessed( state.iterations() * count );
+ * }
+ */
+class State
+{
+public:
+	State( const TreeShape &shape, size_t maxIterations );
+
+	/**
+	 * Starts the timer on the first call, returns false once all iterations ran
+	 */
+	bool keepRunning();
+
+	void pauseTiming();
+	void resumeTiming();
+
+	size_t iterations() const
+	{
+		return maxIterations;
+	}
+
+	void setItemsProcessed( size_t items )
+	{
+		itemsProcessed = items;
+	}
+
+	/**
+	 * Adds a user defined value to the report, averaged over the repetitions
+	 */
+	void counter( const std::string &name, double value );
+
+	const TreeShape &shape;
+
+private:
+	friend class Runner;
+	size_t maxIterations;
+	size_t currentIteration;
+	bool running;
+	Clock::time_point start;
+	Clock::duration elapsed;
+	size_t itemsProcessed;
+	std::vector<std::pair<std::string, double> > counters;
+};
+
+typedef void ( *Function )( State &state );
+
+/**
+ * Registers a benchmark at static initialization time.
+ * Benchmarks not depending on the shape only run once.
+ */
+struct Registrar
+{
+	Registrar( const char* name, Function function, bool perShape = true );
+};
+
+/**
+ * Prevents the compiler from optimizing away a computed value
+ */
+template<typename T>
+inline void doNotOptimize( const T &value )
+{
+	asm volatile( "" : : "g"( &value ) : "memory" );
+}
+
+}
+
+#define SEQUENCE_BENCHMARK_IMPL( name, perShape ) \
+	static void name( bench::State &state ); \
+	static bench::Registrar name##Registrar( #name, &name, perShape ); \
+	static void name( bench::State &state )
+
+#define SEQUENCE_BENCHMARK( name ) SEQUENCE_BENCHMARK_IMPL( name, true )
+
+#define SEQUENCE_BENCHMARK_NO_SHAPE( name ) SEQUENCE_BENCHMARK_IMPL( name, false )
+
+#endif
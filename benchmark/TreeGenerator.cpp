@@ -0,0 +1,243 @@
+#include "TreeGenerator.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <cstdio>
+
+using namespace std;
+
+namespace bench
+{
+
+TreeShape::TreeShape() :
+	name( "flat" ),
+	depth( 0 ),
+	width( 0 ),
+	patterns( 10 ),
+	versions( 0 ),
+	constants( 0 ),
+	resolutions( 0 ),
+	frames( 1000 ),
+	holeEvery( 0 ),
+	singles( 10 ),
+	hashed( 0 )
+{
+}
+
+size_t TreeShape::folders() const
+{
+	size_t count = 1;
+	size_t level = 1;
+	for( size_t i = 0; i < depth; ++i )
+	{
+		level *= width;
+		count += level;
+	}
+	return count;
+}
+
+size_t TreeShape::filesPerFolder() const
+{
+	size_t existing = frames;
+	if( holeEvery )
+		existing -= frames / holeEvery;
+	return patterns * max( size_t( 1 ), resolutions ) * max( size_t( 1 ), versions ) * existing + singles + hashed;
+}
+
+vector<TreeShape> defaultShapes()
+{
+	vector<TreeShape> shapes;
+	TreeShape shape;
+	shapes.push_back( shape );
+
+	shape = TreeShape();
+	shape.name = "deep";
+	shape.depth = 6;
+	shape.width = 2;
+	shape.patterns = 2;
+	shape.frames = 50;
+	shape.singles = 2;
+	shapes.push_back( shape );
+
+	shape = TreeShape();
+	shape.name = "wide";
+	shape.depth = 1;
+	shape.width = 200;
+	shape.patterns = 2;
+	shape.frames = 50;
+	shape.singles = 2;
+	shapes.push_back( shape );
+
+	shape = TreeShape();
+	shape.name = "many_patterns";
+	shape.patterns = 2000;
+	shape.frames = 5;
+	shapes.push_back( shape );
+
+	shape = TreeShape();
+	shape.name = "multi_number";
+	shape.patterns = 4;
+	shape.versions = 5;
+	shape.constants = 2;
+	shape.frames = 200;
+	shapes.push_back( shape );
+
+	// more resolutions than frames, the frame isn't the number having the most values
+	shape = TreeShape();
+	shape.name = "multi_resolution";
+	shape.patterns = 4;
+	shape.resolutions = 24;
+	shape.versions = 3;
+	shape.frames = 12;
+	shapes.push_back( shape );
+
+	shape = TreeShape();
+	shape.name = "holes";
+	shape.frames = 1000;
+	shape.holeEvery = 7;
+	shapes.push_back( shape );
+
+	// nothing to group
+	shape = TreeShape();
+	shape.name = "photo_dump";
+	shape.patterns = 0;
+	shape.singles = 5000;
+	shape.hashed = 20000;
+	shapes.push_back( shape );
+	return shapes;
+}
+
+static string letters( size_t value )
+{
+	string result;
+	do
+	{
+		result.push_back( 'a' + value % 26 );
+		value /= 26;
+	}
+	while( value );
+	return result;
+}
+
+vector<string> generateFilenames( const TreeShape &shape )
+{
+	vector<string> filenames;
+	filenames.reserve( shape.filesPerFolder() );
+	char buffer[32];
+	for( size_t p = 0; p < shape.patterns; ++p )
+	{
+		string name( "seq" );
+		sprintf( buffer, "%lu", static_cast<unsigned long>( p ) );
+		name += buffer;
+		for( size_t c = 0; c < shape.constants; ++c )
+		{
+			sprintf( buffer, "_%lu", static_cast<unsigned long>( 1024 * ( c + 1 ) ) );
+			name += buffer;
+		}
+		for( size_t r = 0; r < max( size_t( 1 ), shape.resolutions ); ++r )
+		{
+			string sized( name );
+			if( shape.resolutions )
+			{
+				sprintf( buffer, "_%lux%lu", static_cast<unsigned long>( 1280 + 64 * r ), static_cast<unsigned long>( 720 + 36 * r ) );
+				sized += buffer;
+			}
+			for( size_t v = 0; v < max( size_t( 1 ), shape.versions ); ++v )
+			{
+				string versioned( sized );
+				if( shape.versions )
+				{
+					sprintf( buffer, "_v%03lu", static_cast<unsigned long>( v + 1 ) );
+					versioned += buffer;
+				}
+				for( size_t f = 1; f <= shape.frames; ++f )
+				{
+					if( shape.holeEvery && f % shape.holeEvery == 0 )
+						continue;
+					sprintf( buffer, ".%04lu.exr", static_cast<unsigned long>( f ) );
+					filenames.push_back( versioned + buffer );
+				}
+			}
+		}
+	}
+	for( size_t s = 0; s < shape.singles; ++s )
+		filenames.push_back( "single_" + letters( s ) + ".txt" );
+	for( size_t h = 0; h < shape.hashed; ++h )
+	{
+		sprintf( buffer, "%08lx.jpg", static_cast<unsigned long>( ( ( h + 1 ) * 2654435761UL ) & 0xffffffffUL ) );
+		filenames.push_back( buffer );
+	}
+	return filenames;
+}
+
+vector<string> generateFolders( const TreeShape &shape )
+{
+	vector<string> folders( 1 );
+	size_t levelBegin = 0;
+	for( size_t level = 0; level < shape.depth; ++level )
+	{
+		const size_t levelEnd = folders.size();
+		for( size_t i = levelBegin; i < levelEnd; ++i )
+		{
+			for( size_t w = 0; w < shape.width; ++w )
+			{
+				const string parent = folders[i];
+				folders.push_back( ( parent.empty() ? parent : parent + '/' ) + "dir_" + letters( w ) );
+			}
+		}
+		levelBegin = levelEnd;
+	}
+	return folders;
+}
+
+/**
+ * A deterministic generator so runs can be compared
+ */
+struct LinearCongruential
+{
+	LinearCongruential() :
+		state( 42 )
+	{}
+
+	ptrdiff_t operator()( ptrdiff_t max )
+	{
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return static_cast<ptrdiff_t>( ( state >> 33 ) % max );
+	}
+
+	unsigned long long state;
+};
+
+vector<string> generatePaths( const TreeShape &shape, const string &root )
+{
+	const vector<string> filenames = generateFilenames( shape );
+	const vector<string> folders = generateFolders( shape );
+	vector<string> paths;
+	paths.reserve( filenames.size() * folders.size() );
+	for( vector<string>::const_iterator folder = folders.begin(); folder != folders.end(); ++folder )
+	{
+		const string prefix = root + '/' + ( folder->empty() ? *folder : *folder + '/' );
+		for( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+			paths.push_back( prefix + *filename );
+	}
+	LinearCongruential generator;
+	random_shuffle( paths.begin(), paths.end(), generator );
+	return paths;
+}
+
+void createTree( const TreeShape &shape, const boost::filesystem::path &root )
+{
+	const vector<string> filenames = generateFilenames( shape );
+	const vector<string> folders = generateFolders( shape );
+	for( vector<string>::const_iterator folder = folders.begin(); folder != folders.end(); ++folder )
+	{
+		const boost::filesystem::path current = root / *folder;
+		boost::filesystem::create_directories( current );
+		for( vector<string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename )
+			boost::filesystem::ofstream( current / *filename );
+	}
+}
+
+}
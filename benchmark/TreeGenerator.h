@@ -0,0 +1,76 @@
+/*
+ * TreeGenerator.h
+ *
+ * Generates synthetic filenames and folder hierarchies.
+ */
+
+#ifndef TREEGENERATOR_H_
+#define TREEGENERATOR_H_
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+/**
+ * Describes a synthetic hierarchy.
+ * Each folder contains 'patterns' x 'resolutions' x 'versions' sequences of
+ * 'frames' files named like : seq12_2048_4096_1280x720_v003.0042.exr plus
+ * 'singles' unique files.
+ */
+struct TreeShape
+{
+	std::string name;
+	size_t depth;     ///< levels of sub folders below the root
+	size_t width;     ///< sub folders per folder
+	size_t patterns;  ///< distinct sequence names per folder
+	size_t versions;  ///< versions per sequence name, 0 means no version number
+	size_t constants; ///< constant numbers embedded in each name
+	size_t resolutions; ///< width x height variants per sequence name, 0 means none
+	size_t frames;    ///< frames per sequence
+	size_t holeEvery; ///< every Nth frame is missing, 0 means no hole
+	size_t singles;   ///< files not belonging to any sequence per folder
+	size_t hashed;    ///< files named after a hexadecimal hash per folder, like 5f3a09c1.jpg
+
+	TreeShape();
+
+	size_t folders() const;
+	size_t filesPerFolder() const;
+	size_t files() const
+	{
+		return folders() * filesPerFolder();
+	}
+};
+
+/**
+ * The predefined shapes : flat, deep, wide, many_patterns, multi_number,
+ * multi_resolution, holes, photo_dump
+ */
+std::vector<TreeShape> defaultShapes();
+
+/**
+ * The filenames of a single folder
+ */
+std::vector<std::string> generateFilenames( const TreeShape &shape );
+
+/**
+ * The relative paths of the folders, root included as ""
+ */
+std::vector<std::string> generateFolders( const TreeShape &shape );
+
+/**
+ * All the file paths of the hierarchy prefixed by root, in random order
+ */
+std::vector<std::string> generatePaths( const TreeShape &shape, const std::string &root );
+
+/**
+ * Creates the hierarchy on disk, files are empty
+ */
+void createTree( const TreeShape &shape, const boost::filesystem::path &root );
+
+}
+
+#endif
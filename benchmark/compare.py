@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+"""
+Compares two JSON reports produced by 'sequence_benchmark --json FILE'.
+
+USAGE: compare.py BASELINE.json CONTENDER.json [--threshold PERCENT]
+
+Prints the relative time change of each benchmark present in both reports and
+exits with status 1 if any of them is slower than the threshold (default 10%).
+"""
+
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as stream:
+        report = json.load(stream)
+    return dict((entry['name'], entry) for entry in report['benchmarks'])
+
+
+def main(argv):
+    args = [arg for arg in argv[1:]]
+    threshold = 10.0
+    if '--threshold' in args:
+        index = args.index('--threshold')
+        threshold = float(args[index + 1])
+        del args[index:index + 2]
+    if len(args) != 2:
+        sys.stderr.write(__doc__)
+        return 2
+
+    baseline = load(args[0])
+    contender = load(args[1])
+    regressions = []
+    print('%-40s %15s %15s %9s' % ('Benchmark', 'Baseline (ns)', 'Contender (ns)', 'Change'))
+    for name in sorted(set(baseline) & set(contender)):
+        before = baseline[name]['real_time']
+        after = contender[name]['real_time']
+        change = (after - before) * 100.0 / before if before else 0.0
+        flag = ''
+        if change > threshold:
+            flag = ' <- regression'
+            regressions.append(name)
+        print('%-40s %15.0f %15.0f %+8.1f%%%s' % (name, before, after, change, flag))
+    for name in sorted(set(baseline) ^ set(contender)):
+        print('%-40s only in %s' % (name, args[0] if name in baseline else args[1]))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -0,0 +1,612 @@
+#include "Benchmark.h"
+#include "Allocations.h"
+
+#include <sequence/parser/BrowseCache.h>
+#include <sequence/parser/Browser.h>
+#include <sequence/parser/Columns.h>
+#include <sequence/parser/Daemon.h>
+#include <sequence/parser/NaturalSort.h>
+#include <sequence/parser/details/Utils.h>
+#include <sequence/DisplayUtils.h>
+#include <sequence/ItemWriter.h>
+#include <sequence/PatternMatcher.h>
+#include <sequence/Sequence.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <sstream>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace sequence;
+using namespace sequence::parser::details;
+
+namespace
+{
+
+/**
+ * Trees are generated on disk once per shape and removed at exit
+ */
+class TemporaryTrees
+{
+public:
+	~TemporaryTrees()
+	{
+		boost::system::error_code ignored;
+		for( map<string, boost::filesystem::path>::const_iterator itr = roots.begin(); itr != roots.end(); ++itr )
+			boost::filesystem::remove_all( itr->second, ignored );
+	}
+
+	const boost::filesystem::path& get( const bench::TreeShape &shape )
+	{
+		const string key = shape.name + '_' + boost::lexical_cast<string>( shape.frames );
+		map<string, boost::filesystem::path>::iterator found = roots.find( key );
+		if( found == roots.end() )
+		{
+			const boost::filesystem::path root = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "sequence-bench-%%%%-%%%%" );
+			bench::createTree( shape, root );
+			found = roots.insert( make_pair( key, root ) ).first;
+		}
+		return found->second;
+	}
+
+private:
+	map<string, boost::filesystem::path> roots;
+};
+
+TemporaryTrees gTrees;
+
+static PatternsPerDir fillPatterns( const vector<string> &filenames )
+{
+	TmpData tmp;
+	PatternsPerDir patterns;
+	for( vector<string>::const_iterator itr = filenames.begin(); itr != filenames.end(); ++itr )
+		insert( tmp, patterns, *itr );
+	return patterns;
+}
+
+typedef boost::unordered_map<string, Pattern> NodePatternsPerDir;
+
+/**
+ * Inserts the filenames of a directory in a Map, presized or not
+ */
+template<typename Map>
+static void insertPatterns( bench::State &state, bool presize )
+{
+	const vector<string> filenames = bench::generateFilenames( state.shape );
+	size_t patterns = 0;
+	while( state.keepRunning() )
+	{
+		TmpData tmp;
+		Map map;
+		if( presize )
+			map.reserve( filenames.size() );
+		for( vector<string>::const_iterator itr = filenames.begin(); itr != filenames.end(); ++itr )
+			insert( tmp, map, *itr );
+		patterns = map.size();
+		bench::doNotOptimize( map );
+	}
+	state.setItemsProcessed( state.iterations() * filenames.size() );
+	state.counter( "patterns", patterns );
+}
+
+/**
+ * Patterns created while computing the results, splits included
+ */
+static size_t createdPatterns( const vector<string> &paths, sequence::parser::SplitStrategy strategy )
+{
+	sequence::parser::Statistics statistics;
+	Parser parser;
+	parser.setStatistics( &statistics );
+	parser.setSplitStrategy( strategy );
+	for_each( paths.begin(), paths.end(), parser.functor() );
+	parser.getResults();
+	return statistics.patterns;
+}
+
+static void getResults( bench::State &state, sequence::parser::SplitStrategy strategy )
+{
+	const vector<string> paths = bench::generatePaths( state.shape, "/s" );
+	size_t results = 0;
+	size_t allocations = 0;
+	size_t bytes = 0;
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		Parser parser;
+		parser.setSplitStrategy( strategy );
+		for_each( paths.begin(), paths.end(), parser.functor() );
+		vector<BrowseItem> items;
+		const size_t allocationsBefore = bench::allocationCount();
+		const size_t bytesBefore = bench::allocatedBytes();
+		state.resumeTiming();
+		parser.releaseResults( items );
+		state.pauseTiming();
+		allocations = bench::allocationCount() - allocationsBefore;
+		bytes = bench::allocatedBytes() - bytesBefore;
+		results = items.size();
+		state.resumeTiming();
+	}
+	state.setItemsProcessed( state.iterations() * paths.size() );
+	state.counter( "results", results );
+	state.counter( "created_patterns", createdPatterns( paths, strategy ) );
+	state.counter( "allocations_per_item", results ? double( allocations ) / results : 0 );
+	state.counter( "bytes_per_item", results ? double( bytes ) / results : 0 );
+}
+
+}
+
+SEQUENCE_BENCHMARK( ExtractPattern )
+{
+	const vector<string> filenames = bench::generateFilenames( state.shape );
+	Locations locations;
+	Values values;
+	string key;
+	while( state.keepRunning() )
+	{
+		for( vector<string>::const_iterator itr = filenames.begin(); itr != filenames.end(); ++itr )
+		{
+			key = *itr;
+			extractPattern( key, locations, values );
+			bench::doNotOptimize( values );
+		}
+	}
+	state.setItemsProcessed( state.iterations() * filenames.size() );
+}
+
+SEQUENCE_BENCHMARK( Insert )
+{
+	const vector<string> paths = bench::generatePaths( state.shape, "/s" );
+	while( state.keepRunning() )
+	{
+		Parser parser;
+		for_each( paths.begin(), paths.end(), parser.functor() );
+		bench::doNotOptimize( parser );
+	}
+	state.setItemsProcessed( state.iterations() * paths.size() );
+}
+
+SEQUENCE_BENCHMARK( InsertPatterns )
+{
+	insertPatterns<PatternsPerDir>( state, false );
+}
+
+SEQUENCE_BENCHMARK( InsertPatternsPresized )
+{
+	insertPatterns<PatternsPerDir>( state, true );
+}
+
+SEQUENCE_BENCHMARK( InsertPatternsNodeMap )
+{
+	insertPatterns<NodePatternsPerDir>( state, false );
+}
+
+SEQUENCE_BENCHMARK( InsertPatternsNodeMapPresized )
+{
+	insertPatterns<NodePatternsPerDir>( state, true );
+}
+
+SEQUENCE_BENCHMARK( Prepare )
+{
+	const PatternsPerDir filled = fillPatterns( bench::generateFilenames( state.shape ) );
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		PatternsPerDir patterns( filled );
+		state.resumeTiming();
+		for( PatternsPerDir::iterator itr = patterns.begin(); itr != patterns.end(); ++itr )
+		{
+			itr->second.prepare();
+			itr->second.bakeConstantLocations();
+		}
+		bench::doNotOptimize( patterns );
+	}
+	state.setItemsProcessed( state.iterations() * filled.size() );
+	state.counter( "patterns", filled.size() );
+}
+
+SEQUENCE_BENCHMARK( Split )
+{
+	PatternsPerDir patterns = fillPatterns( bench::generateFilenames( state.shape ) );
+	vector<Pattern> splittable;
+	for( PatternsPerDir::iterator itr = patterns.begin(); itr != patterns.end(); ++itr )
+	{
+		itr->second.prepare();
+		itr->second.bakeConstantLocations();
+		if( itr->second.locationData.size() > 1 )
+			splittable.push_back( itr->second );
+	}
+	size_t created = 0;
+	while( state.keepRunning() )
+	{
+		created = 0;
+		for( vector<Pattern>::const_iterator itr = splittable.begin(); itr != splittable.end(); ++itr )
+		{
+			Splitter splitter( *itr );
+			created += splitter.patterns.size();
+			bench::doNotOptimize( splitter.patterns );
+		}
+	}
+	state.setItemsProcessed( state.iterations() * splittable.size() );
+	state.counter( "split_patterns", splittable.size() );
+	state.counter( "created_patterns", created );
+}
+
+SEQUENCE_BENCHMARK( GetRangesAndStep )
+{
+	const vector<string> filenames = bench::generateFilenames( state.shape );
+	set<value_type> frames;
+	Locations locations;
+	Values values;
+	for( vector<string>::const_iterator itr = filenames.begin(); itr != filenames.end(); ++itr )
+	{
+		string key = *itr;
+		extractPattern( key, locations, values );
+		if( !values.empty() )
+			frames.insert( values.back() );
+	}
+	const Set sorted( frames.begin(), frames.end() );
+	size_t step;
+	while( state.keepRunning() )
+	{
+		const Ranges ranges = getRangesAndStep( sorted.begin(), sorted.end(), step );
+		bench::doNotOptimize( ranges );
+	}
+	state.setItemsProcessed( state.iterations() * sorted.size() );
+}
+
+SEQUENCE_BENCHMARK( GetResults )
+{
+	getResults( state, sequence::parser::SPLIT_FRAME_LAST );
+}
+
+SEQUENCE_BENCHMARK( GetResultsFewestValues )
+{
+	getResults( state, sequence::parser::SPLIT_FEWEST_VALUES );
+}
+
+SEQUENCE_BENCHMARK( GetLatestVersions )
+{
+	const vector<string> paths = bench::generatePaths( state.shape, "/s" );
+	size_t results = 0;
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		Parser parser;
+		parser.setVersionPrefix( "_v" );
+		for_each( paths.begin(), paths.end(), parser.functor() );
+		vector<BrowseItem> items;
+		state.resumeTiming();
+		parser.releaseResults( items );
+		state.pauseTiming();
+		results = items.size();
+		state.resumeTiming();
+	}
+	state.setItemsProcessed( state.iterations() * paths.size() );
+	state.counter( "results", results );
+}
+
+SEQUENCE_BENCHMARK( GetColumns )
+{
+	const vector<string> paths = bench::generatePaths( state.shape, "/s" );
+	size_t results = 0;
+	size_t allocations = 0;
+	size_t bytes = 0;
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		Parser parser;
+		for_each( paths.begin(), paths.end(), parser.functor() );
+		sequence::parser::Columns columns;
+		const size_t allocationsBefore = bench::allocationCount();
+		const size_t bytesBefore = bench::allocatedBytes();
+		state.resumeTiming();
+		parser.releaseColumns( columns );
+		state.pauseTiming();
+		allocations = bench::allocationCount() - allocationsBefore;
+		bytes = bench::allocatedBytes() - bytesBefore;
+		results = columns.size();
+		state.resumeTiming();
+	}
+	state.setItemsProcessed( state.iterations() * paths.size() );
+	state.counter( "results", results );
+	state.counter( "allocations_per_item", results ? double( allocations ) / results : 0 );
+	state.counter( "bytes_per_item", results ? double( bytes ) / results : 0 );
+}
+
+SEQUENCE_BENCHMARK( Browse )
+{
+	const string root = gTrees.get( state.shape ).string();
+	size_t results = 0;
+	const size_t allocationsBefore = bench::allocationCount();
+	const size_t bytesBefore = bench::allocatedBytes();
+	while( state.keepRunning() )
+		results = sequence::parser::browse( root.c_str(), true ).size();
+	const double runs = double( state.iterations() ) * results;
+	state.setItemsProcessed( state.iterations() * state.shape.files() );
+	state.counter( "results", results );
+	state.counter( "allocations_per_item", runs ? ( bench::allocationCount() - allocationsBefore ) / runs : 0 );
+	state.counter( "bytes_per_item", runs ? ( bench::allocatedBytes() - bytesBefore ) / runs : 0 );
+}
+
+#ifdef SEQUENCEPARSER_HAS_DAEMON
+SEQUENCE_BENCHMARK( BrowseDaemon )
+{
+	const boost::filesystem::path &root = gTrees.get( state.shape );
+	// the daemon does not cache the listings of directories modified just now
+	const time_t past = time( NULL ) - 60;
+	boost::filesystem::last_write_time( root, past );
+	for( boost::filesystem::recursive_directory_iterator itr( root ), end; itr != end; ++itr )
+		if( is_directory( itr->symlink_status() ) )
+			boost::filesystem::last_write_time( itr->path(), past );
+	const string socketPath = ( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path( "sequence-bench-%%%%-%%%%.sock" ) ).string();
+	sequence::parser::DaemonServer server( socketPath );
+	boost::thread serving( boost::bind( &sequence::parser::DaemonServer::run, &server, 1 ) );
+	size_t results = 0;
+	{
+		sequence::parser::DaemonClient client( socketPath );
+		sequence::parser::BrowseOptions options;
+		options.recursive = true;
+		while( state.keepRunning() )
+			results = client.browse( root.string().c_str(), options ).size();
+	}
+	server.stop();
+	serving.join();
+	const sequence::parser::DaemonCounters counters = server.counters();
+	state.setItemsProcessed( state.iterations() * state.shape.files() );
+	state.counter( "results", results );
+	state.counter( "hit_ratio", counters.hits + counters.misses ? double( counters.hits ) / ( counters.hits + counters.misses ) : 0 );
+}
+#endif
+
+SEQUENCE_BENCHMARK( BrowseCached )
+{
+	const boost::filesystem::path &root = gTrees.get( state.shape );
+	// directories modified just now are not cached
+	const time_t past = time( NULL ) - 60;
+	boost::filesystem::last_write_time( root, past );
+	for( boost::filesystem::recursive_directory_iterator itr( root ), end; itr != end; ++itr )
+		if( is_directory( itr->symlink_status() ) )
+			boost::filesystem::last_write_time( itr->path(), past );
+	sequence::parser::BrowseCache cache;
+	sequence::parser::BrowseOptions options;
+	options.recursive = true;
+	size_t results = 0;
+	while( state.keepRunning() )
+		results = cache.browse( root.string().c_str(), options ).size();
+	const sequence::parser::BrowseCacheCounters counters = cache.counters();
+	state.setItemsProcessed( state.iterations() * state.shape.files() );
+	state.counter( "results", results );
+	state.counter( "hit_ratio", counters.hits + counters.misses ? double( counters.hits ) / ( counters.hits + counters.misses ) : 0 );
+}
+
+static vector<BrowseItem> unsortedItems()
+{
+	vector<BrowseItem> items;
+	for( int i = 0; i < 200000; ++i )
+	{
+		const string directory = "/s/prods/shot" + boost::lexical_cast<string>( ( i * 7919 ) % 500 );
+		if( i % 4 )
+			items.push_back( create_file( directory + "/take" + boost::lexical_cast<string>( i ) + ".mov" ) );
+		else
+			items.push_back( create_sequence( directory, SequencePattern( "comp_v" + boost::lexical_cast<string>( i ) + ".", ".exr", 4 ), Range( 1, 100 ) ) );
+	}
+	return items;
+}
+
+static bool pathLess( const BrowseItem &a, const BrowseItem &b )
+{
+	return a.path.string() + a.sequence.pattern.string() < b.path.string() + b.sequence.pattern.string();
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( SortItemsByPath )
+{
+	const vector<BrowseItem> unsorted = unsortedItems();
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		vector<BrowseItem> items( unsorted );
+		state.resumeTiming();
+		sort( items.begin(), items.end(), pathLess );
+	}
+	state.setItemsProcessed( state.iterations() * unsorted.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( SortItemsNatural )
+{
+	const vector<BrowseItem> unsorted = unsortedItems();
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		vector<BrowseItem> items( unsorted );
+		state.resumeTiming();
+		sequence::parser::sortItems( items );
+	}
+	state.setItemsProcessed( state.iterations() * unsorted.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( SortItemsNaturalSingleThread )
+{
+	const vector<BrowseItem> unsorted = unsortedItems();
+	while( state.keepRunning() )
+	{
+		state.pauseTiming();
+		vector<BrowseItem> items( unsorted );
+		state.resumeTiming();
+		sequence::parser::sortItems( items, 1 );
+	}
+	state.setItemsProcessed( state.iterations() * unsorted.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( InstanciatePattern )
+{
+	const SequencePattern pattern = parsePattern( "/s/prods/shot010/comp_v003.####.exr" );
+	const unsigned int frames = 10000;
+	while( state.keepRunning() )
+	{
+		for( unsigned int frame = 0; frame < frames; ++frame )
+		{
+			const string filename = instanciatePattern( pattern, frame );
+			bench::doNotOptimize( filename );
+		}
+	}
+	state.setItemsProcessed( state.iterations() * frames );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( MatchPattern )
+{
+	const SequencePattern pattern = parsePattern( "comp_LGT-prepaanimatic-shot01_v003.####.exr" );
+	string block;
+	const unsigned int frames = 10000;
+	for( unsigned int frame = 0; frame < frames; ++frame )
+		block += instanciatePattern( frame % 10 ? pattern : SequencePattern( "other.", ".dpx", 4 ), frame ) + '\n';
+	const PatternMatcher matcher( pattern );
+	vector<unsigned int> matched;
+	while( state.keepRunning() )
+	{
+		matched.clear();
+		matcher.matchBlock( block.data(), block.data() + block.size(), '\n', matched );
+		bench::doNotOptimize( matched );
+	}
+	state.setItemsProcessed( state.iterations() * frames );
+	state.counter( "matched", matched.size() );
+}
+
+static vector<BrowseItem> formattedItems()
+{
+	vector<BrowseItem> items;
+	for( unsigned int i = 0; i < 10000; ++i )
+	{
+		if( i % 2 )
+			items.push_back( create_file( "/s/prods/shot010/notes_" + instanciatePattern( SequencePattern( "", ".txt", 4 ), i ) ) );
+		else
+			items.push_back( create_sequence( "/s/prods/shot010", SequencePattern( "comp_v003.", ".exr", 4 ), Range( 1, i + 1 ) ) );
+	}
+	return items;
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( FormatItemsStream )
+{
+	const vector<BrowseItem> items = formattedItems();
+	FILE *null = fopen( "/dev/null", "w" );
+	while( state.keepRunning() )
+	{
+		ostringstream stream;
+		copy( items.begin(), items.end(), ostream_iterator<BrowseItem>( stream, "\n" ) );
+		fputs( stream.str().c_str(), null );
+	}
+	fclose( null );
+	state.setItemsProcessed( state.iterations() * items.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( FormatItemsWriter )
+{
+	const vector<BrowseItem> items = formattedItems();
+	FILE *null = fopen( "/dev/null", "w" );
+	while( state.keepRunning() )
+	{
+		ItemWriter writer( null );
+		writer.write( items.begin(), items.end() );
+	}
+	fclose( null );
+	state.setItemsProcessed( state.iterations() * items.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( InterpolateSource )
+{
+	const Range source( 1001, 1240 );
+	const Range record( 86400, 86400 + 999 );
+	while( state.keepRunning() )
+		for( unsigned int frame = record.first; frame <= record.last; ++frame )
+			bench::doNotOptimize( interpolateSource( frame, source, record, false ) );
+	state.setItemsProcessed( state.iterations() * record.duration() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( InterpolateSources )
+{
+	const Range source( 1001, 1240 );
+	const Range record( 86400, 86400 + 999 );
+	vector<unsigned int> frames( record.duration() );
+	while( state.keepRunning() )
+	{
+		interpolateSources( source, record, false, &frames[0] );
+		bench::doNotOptimize( frames );
+	}
+	state.setItemsProcessed( state.iterations() * record.duration() );
+}
+
+/**
+ * A playback ring buffer : every slot moves by its own offset each tick
+ */
+struct RingBuffer
+{
+	RingBuffer() :
+		range( 1001, 1240 )
+	{
+		for( unsigned int i = 0; i < 4096; ++i )
+		{
+			current.push_back( range.first + i % range.duration() );
+			offsets.push_back( static_cast<int>( i % 64 ) - 32 );
+		}
+		frames.resize( current.size() );
+	}
+
+	const Range range;
+	vector<unsigned int> current;
+	vector<int> offsets;
+	vector<unsigned int> frames;
+};
+
+SEQUENCE_BENCHMARK_NO_SHAPE( OffsetLoopFrame )
+{
+	RingBuffer ring;
+	while( state.keepRunning() )
+	{
+		for( size_t i = 0; i < ring.current.size(); ++i )
+			ring.frames[i] = ring.range.offsetLoopFrame( ring.current[i], ring.offsets[i] ).first;
+		bench::doNotOptimize( ring.frames );
+	}
+	state.setItemsProcessed( state.iterations() * ring.current.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( OffsetLoopFrames )
+{
+	RingBuffer ring;
+	while( state.keepRunning() )
+	{
+		ring.range.offsetLoopFrames( &ring.current[0], &ring.offsets[0], ring.current.size(), &ring.frames[0] );
+		bench::doNotOptimize( ring.frames );
+	}
+	state.setItemsProcessed( state.iterations() * ring.current.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( OffsetClampFrame )
+{
+	RingBuffer ring;
+	while( state.keepRunning() )
+	{
+		for( size_t i = 0; i < ring.current.size(); ++i )
+			ring.frames[i] = ring.range.offsetClampFrame( ring.current[i], ring.offsets[i] ).first;
+		bench::doNotOptimize( ring.frames );
+	}
+	state.setItemsProcessed( state.iterations() * ring.current.size() );
+}
+
+SEQUENCE_BENCHMARK_NO_SHAPE( OffsetClampFrames )
+{
+	RingBuffer ring;
+	while( state.keepRunning() )
+	{
+		ring.range.offsetClampFrames( &ring.current[0], &ring.offsets[0], ring.current.size(), &ring.frames[0] );
+		bench::doNotOptimize( ring.frames );
+	}
+	state.setItemsProcessed( state.iterations() * ring.current.size() );
+}
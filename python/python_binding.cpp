@@ -1,10 +1,18 @@
 #include <boost/python.hpp>
+#include <boost/python/stl_iterator.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/python/suite/indexing/vector_indexing_suite.hpp>
 
 #include <sequence/parser/Browser.h>
+#include <sequence/parser/Columns.h>
+#include <sequence/parser/FlatItems.h>
+#include <sequence/parser/Statistics.h>
+#include <sequence/parser/Walker.h>
 #include <sequence/BrowseItem.h>
 
 #include <vector>
+#include <sstream>
+#include <cstring>
 
 using namespace boost::python;
 using namespace std;
@@ -16,6 +24,347 @@ string pathAsString( const BrowseItem& item )
 	return item.path.string();
 }
 
+string statisticsAsString( const Statistics& statistics )
+{
+	ostringstream stream;
+	stream << statistics;
+	return stream.str();
+}
+
+/**
+ * Lets other Python threads run while in scope.
+ * No Python object must be touched meanwhile.
+ */
+class ScopedGILRelease
+{
+public:
+	ScopedGILRelease() :
+		state( PyEval_SaveThread() )
+	{
+	}
+
+	~ScopedGILRelease()
+	{
+		PyEval_RestoreThread( state );
+	}
+
+private:
+	PyThreadState *state;
+};
+
+/**
+ * Converts the items to a plain Python list
+ */
+boost::python::list toList( const BrowseItems& items )
+{
+	boost::python::list result;
+	for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+		result.append( *itr );
+	return result;
+}
+
+boost::python::list browseOptions( const char* directory, const BrowseOptions& options )
+{
+	BrowseItems items;
+	{
+		ScopedGILRelease release;
+		browse( directory, options ).swap( items );
+	}
+	return toList( items );
+}
+
+boost::python::list browseDirectory( const char* directory, bool recursive )
+{
+	BrowseOptions options;
+	options.recursive = recursive;
+	return browseOptions( directory, options );
+}
+
+/**
+ * Returns a ( list of BrowseItem, Statistics ) tuple
+ */
+boost::python::tuple browseWithStatistics( const char* directory, BrowseOptions options )
+{
+	Statistics statistics;
+	options.statistics = &statistics;
+	const boost::python::list items = browseOptions( directory, options );
+	return boost::python::make_tuple( items, statistics );
+}
+
+/**
+ * Browses an iterable of directories concurrently, returns a list of lists
+ */
+boost::python::list browseManyDirectories( boost::python::object directories, BrowseOptions options, size_t threads )
+{
+	const vector<string> folders( stl_input_iterator<string>( directories ), ( stl_input_iterator<string>() ) );
+	options.statistics = NULL;
+	vector<BrowseItems> results;
+	{
+		ScopedGILRelease release;
+		browseMany( folders, options, threads ).swap( results );
+	}
+	boost::python::list result;
+	for( vector<BrowseItems>::const_iterator itr = results.begin(); itr != results.end(); ++itr )
+		result.append( toList( *itr ) );
+	return result;
+}
+
+typedef boost::shared_ptr<Columns> ColumnsPtr;
+
+/**
+ * A read only, one dimensional view over a column exposing the buffer
+ * protocol : numpy.asarray( column ) or memoryview( column ) don't copy.
+ * It keeps the Columns alive.
+ */
+struct ColumnObject
+{
+	PyObject_HEAD
+	ColumnsPtr *owner;
+	const void *data;
+	Py_ssize_t length;
+	Py_ssize_t itemSize;
+	const char *format;
+};
+
+static void columnDealloc( PyObject *self )
+{
+	delete reinterpret_cast<ColumnObject*>( self )->owner;
+	Py_TYPE( self )->tp_free( self );
+}
+
+static Py_ssize_t columnLength( PyObject *self )
+{
+	return reinterpret_cast<ColumnObject*>( self )->length;
+}
+
+static int columnGetBuffer( PyObject *self, Py_buffer *view, int flags )
+{
+	if( flags & PyBUF_WRITABLE )
+	{
+		PyErr_SetString( PyExc_BufferError, "Column is read only" );
+		view->obj = NULL;
+		return -1;
+	}
+	ColumnObject *column = reinterpret_cast<ColumnObject*>( self );
+	view->buf = const_cast<void*>( column->data );
+	view->obj = self;
+	Py_INCREF( self );
+	view->len = column->length * column->itemSize;
+	view->readonly = 1;
+	view->itemsize = column->itemSize;
+	view->format = ( flags & PyBUF_FORMAT ) ? const_cast<char*>( column->format ) : NULL;
+	view->ndim = 1;
+	view->shape = ( flags & PyBUF_ND ) == PyBUF_ND ? &column->length : NULL;
+	view->strides = ( flags & PyBUF_STRIDES ) == PyBUF_STRIDES ? &column->itemSize : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+static PyBufferProcs columnBufferProcs;
+static PySequenceMethods columnSequenceMethods;
+static PyTypeObject columnType;
+
+static void registerColumnType( boost::python::scope &module )
+{
+	std::memset( &columnType, 0, sizeof( columnType ) );
+#if PY_VERSION_HEX >= 0x03090000
+	Py_SET_REFCNT( &columnType, 1 );
+#else
+	Py_REFCNT( &columnType ) = 1;
+#endif
+	columnBufferProcs.bf_getbuffer = columnGetBuffer;
+	columnSequenceMethods.sq_length = columnLength;
+	columnType.tp_name = "sequenceparser.Column";
+	columnType.tp_basicsize = sizeof( ColumnObject );
+	columnType.tp_dealloc = columnDealloc;
+	columnType.tp_as_sequence = &columnSequenceMethods;
+	columnType.tp_as_buffer = &columnBufferProcs;
+	columnType.tp_flags = Py_TPFLAGS_DEFAULT;
+	columnType.tp_doc = "Read only array of a Columns field, supports the buffer protocol";
+	if( PyType_Ready( &columnType ) < 0 )
+		throw_error_already_set();
+	Py_INCREF( &columnType );
+	module.attr( "Column" ) = object( handle<>( reinterpret_cast<PyObject*>( &columnType ) ) );
+}
+
+template<typename T>
+const char* bufferFormat();
+template<> const char* bufferFormat<boost::uint8_t>() { return "B"; }
+template<> const char* bufferFormat<boost::uint16_t>() { return "H"; }
+template<> const char* bufferFormat<boost::uint32_t>() { return "I"; }
+
+template<typename T, std::vector<T> Columns::*field>
+object column( ColumnsPtr columns )
+{
+	ColumnObject *result = PyObject_New( ColumnObject, &columnType );
+	if( !result )
+		throw_error_already_set();
+	const std::vector<T> &values = ( *columns ).*field;
+	result->owner = new ColumnsPtr( columns );
+	result->data = values.empty() ? NULL : &values[0];
+	result->length = values.size();
+	result->itemSize = sizeof( T );
+	result->format = bufferFormat<T>();
+	return object( handle<>( reinterpret_cast<PyObject*>( result ) ) );
+}
+
+BrowseItem columnItem( const Columns &columns, size_t index )
+{
+	if( index >= columns.size() )
+	{
+		PyErr_SetString( PyExc_IndexError, "Columns index out of range" );
+		throw_error_already_set();
+	}
+	return columns.item( index );
+}
+
+boost::python::list columnStrings( ColumnsPtr columns )
+{
+	boost::python::list result;
+	for( vector<string>::const_iterator itr = columns->strings.begin(); itr != columns->strings.end(); ++itr )
+		result.append( *itr );
+	return result;
+}
+
+/**
+ * Browses and returns the results as Columns, no Python object is created per item
+ */
+ColumnsPtr browseColumns( const char* directory, const BrowseOptions& options )
+{
+	ScopedGILRelease release;
+	return ColumnsPtr( new Columns( toColumns( browse( directory, options ) ) ) );
+}
+
+typedef boost::shared_ptr<FlatItems> FlatItemsPtr;
+
+object flatString( const FlatItems &items, boost::uint32_t index )
+{
+	const boost::string_ref value = items.string( index );
+#if PY_MAJOR_VERSION >= 3
+	PyObject *result = PyUnicode_DecodeFSDefaultAndSize( value.data(), value.size() );
+#else
+	PyObject *result = PyString_FromStringAndSize( value.data(), value.size() );
+#endif
+	if( !result )
+		throw_error_already_set();
+	return object( handle<>( result ) );
+}
+
+void checkFlatIndex( const FlatItems &items, size_t index )
+{
+	if( index >= items.size() )
+	{
+		PyErr_SetString( PyExc_IndexError, "FlatItems index out of range" );
+		throw_error_already_set();
+	}
+}
+
+/**
+ * Returns the ( type, directory, prefix, suffix, first, last, step, padding )
+ * tuple of a record, no BrowseItem is built
+ */
+boost::python::tuple flatRecord( const FlatItems &items, size_t index )
+{
+	checkFlatIndex( items, index );
+	const FlatRecord &record = items.record( index );
+	return boost::python::make_tuple( BrowseItemType( record.type ),
+									  flatString( items, record.directory ),
+									  flatString( items, record.prefix ),
+									  flatString( items, record.suffix ),
+									  record.first, record.last, record.step, record.padding );
+}
+
+BrowseItem flatItem( const FlatItems &items, size_t index )
+{
+	checkFlatIndex( items, index );
+	return items.item( index );
+}
+
+/**
+ * Python iterator over the record tuples of a FlatItems
+ */
+class FlatIterator
+{
+public:
+	FlatIterator( FlatItemsPtr items ) :
+		items( items ),
+		index( 0 )
+	{
+	}
+
+	boost::python::tuple next()
+	{
+		if( index == items->size() )
+			objects::stop_iteration_error();
+		return flatRecord( *items, index++ );
+	}
+
+private:
+	FlatItemsPtr items;
+	size_t index;
+};
+
+FlatIterator iterateFlat( FlatItemsPtr items )
+{
+	return FlatIterator( items );
+}
+
+/**
+ * Writes an iterable of BrowseItem as a flat file
+ */
+void writeFlatItems( const char* filename, object items )
+{
+	const BrowseItems values( ( stl_input_iterator<BrowseItem>( items ) ), stl_input_iterator<BrowseItem>() );
+	ScopedGILRelease release;
+	writeFlat( filename, values );
+}
+
+/**
+ * Python iterator over the items of a Walker, directories are browsed
+ * lazily with the GIL released
+ */
+class ItemIterator : boost::noncopyable
+{
+public:
+	ItemIterator( const string &directory, const BrowseOptions &options ) :
+		walker( directory.c_str(), options ),
+		nextItem( 0 )
+	{
+	}
+
+	BrowseItem next()
+	{
+		while( nextItem == items.size() )
+		{
+			bool more;
+			{
+				ScopedGILRelease release;
+				more = walker.next( items );
+			}
+			nextItem = 0;
+			if( !more )
+				objects::stop_iteration_error();
+		}
+		return items[nextItem++];
+	}
+
+private:
+	Walker walker;
+	BrowseItems items;
+	size_t nextItem;
+};
+
+boost::shared_ptr<ItemIterator> walk( const string &directory, const BrowseOptions &options )
+{
+	return boost::shared_ptr<ItemIterator>( new ItemIterator( directory, options ) );
+}
+
+object identity( object self )
+{
+	return self;
+}
+
 BOOST_PYTHON_MODULE( sequenceparser )
 {
 	class_<Range>( "Range" )
@@ -29,10 +378,18 @@ BOOST_PYTHON_MODULE( sequenceparser )
 		.def_readonly( "padding", &SequencePattern::padding )
 		;
 
+	class_<Metadata>( "Metadata" )
+		.def_readonly( "size", &Metadata::size )
+		.def_readonly( "minTime", &Metadata::minTime )
+		.def_readonly( "maxTime", &Metadata::maxTime )
+		.def_readonly( "count", &Metadata::count )
+		;
+
 	class_<Sequence>( "Sequence" )
 		.def_readonly( "pattern", &Sequence::pattern )
 		.def_readonly( "range", &Sequence::range )
 		.def_readonly( "step", &Sequence::step )
+		.def_readonly( "metadata", &Sequence::metadata )
 		;
 
 	enum_<BrowseItemType>( "BrowseItemType" )
@@ -52,5 +409,85 @@ BOOST_PYTHON_MODULE( sequenceparser )
 		.def( vector_indexing_suite<BrowseItems>() )
 		;
 
-	def( "browse", browse );
+	enum_<SplitStrategy>( "SplitStrategy" )
+		.value( "SPLIT_FRAME_LAST", SPLIT_FRAME_LAST )
+		.value( "SPLIT_FEWEST_VALUES", SPLIT_FEWEST_VALUES )
+		;
+
+	class_<BrowseOptions>( "BrowseOptions" )
+		.def_readwrite( "recursive", &BrowseOptions::recursive )
+		.def_readwrite( "gatherMetadata", &BrowseOptions::gatherMetadata )
+		.def_readwrite( "sorted", &BrowseOptions::sorted )
+		.def_readwrite( "versionPrefix", &BrowseOptions::versionPrefix )
+		.def_readwrite( "splitStrategy", &BrowseOptions::splitStrategy )
+		.def_readwrite( "presize", &BrowseOptions::presize )
+		.def_readwrite( "followSymlinks", &BrowseOptions::followSymlinks )
+		;
+
+	class_<Statistics>( "Statistics" )
+		.def_readonly( "readdirTime", &Statistics::readdirTime )
+		.def_readonly( "extractTime", &Statistics::extractTime )
+		.def_readonly( "lookupTime", &Statistics::lookupTime )
+		.def_readonly( "prepareTime", &Statistics::prepareTime )
+		.def_readonly( "splitTime", &Statistics::splitTime )
+		.def_readonly( "resultsTime", &Statistics::resultsTime )
+		.def_readonly( "typeTime", &Statistics::typeTime )
+		.def_readonly( "metadataTime", &Statistics::metadataTime )
+		.def_readonly( "sortTime", &Statistics::sortTime )
+		.def_readonly( "syscalls", &Statistics::syscalls )
+		.def_readonly( "directories", &Statistics::directories )
+		.def_readonly( "entries", &Statistics::entries )
+		.def_readonly( "patterns", &Statistics::patterns )
+		.def_readonly( "splits", &Statistics::splits )
+		.def_readonly( "results", &Statistics::results )
+		.def_readonly( "bytesAllocated", &Statistics::bytesAllocated )
+		.def( "totalTime", &Statistics::totalTime )
+		.def( "__str__", statisticsAsString )
+		;
+
+	def( "browse", ::browseDirectory, ( boost::python::arg( "directory" ), boost::python::arg( "recursive" ) = false ) );
+	def( "browse", browseOptions, ( boost::python::arg( "directory" ), boost::python::arg( "options" ) ) );
+	def( "browseWithStatistics", browseWithStatistics );
+	class_<Columns, ColumnsPtr, boost::noncopyable>( "Columns", no_init )
+		.add_property( "types", column<boost::uint8_t, &Columns::types> )
+		.add_property( "directories", column<boost::uint32_t, &Columns::directories> )
+		.add_property( "prefixes", column<boost::uint32_t, &Columns::prefixes> )
+		.add_property( "suffixes", column<boost::uint32_t, &Columns::suffixes> )
+		.add_property( "firsts", column<boost::uint32_t, &Columns::firsts> )
+		.add_property( "lasts", column<boost::uint32_t, &Columns::lasts> )
+		.add_property( "steps", column<boost::uint16_t, &Columns::steps> )
+		.add_property( "paddings", column<boost::uint8_t, &Columns::paddings> )
+		.add_property( "strings", columnStrings )
+		.def( "item", columnItem )
+		.def( "__len__", &Columns::size )
+		;
+
+	scope module;
+	registerColumnType( module );
+
+	class_<ItemIterator, boost::shared_ptr<ItemIterator>, boost::noncopyable>( "ItemIterator", no_init )
+		.def( "__iter__", identity )
+		.def( "__next__", &ItemIterator::next )
+		.def( "next", &ItemIterator::next )
+		;
+
+	class_<FlatItems, FlatItemsPtr, boost::noncopyable>( "FlatItems", init<const char*>() )
+		.def( "__len__", &FlatItems::size )
+		.def( "__getitem__", flatRecord )
+		.def( "__iter__", iterateFlat )
+		.def( "record", flatRecord )
+		.def( "item", flatItem )
+		;
+
+	class_<FlatIterator>( "FlatIterator", no_init )
+		.def( "__iter__", identity )
+		.def( "__next__", &FlatIterator::next )
+		.def( "next", &FlatIterator::next )
+		;
+
+	def( "writeFlat", writeFlatItems, ( boost::python::arg( "filename" ), boost::python::arg( "items" ) ) );
+
+	def( "walk", walk, ( boost::python::arg( "directory" ), boost::python::arg( "options" ) = BrowseOptions() ) );
+	def( "browseColumns", browseColumns, ( boost::python::arg( "directory" ), boost::python::arg( "options" ) = BrowseOptions() ) );
+	def( "browseMany", browseManyDirectories, ( boost::python::arg( "directories" ), boost::python::arg( "options" ) = BrowseOptions(), boost::python::arg( "threads" ) = 0 ) );
 }
@@ -0,0 +1,226 @@
+#include "ItemWriter.h"
+#include "DisplayUtils.h"
+
+#include <boost/filesystem/path.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace sequence
+{
+
+namespace
+{
+
+inline bool isSeparator( char c )
+{
+#ifdef BOOST_WINDOWS_API
+	return c == '/' || c == '\\';
+#else
+	return c == '/';
+#endif
+}
+
+/**
+ * The path of an item as written by operator<<, joined like
+ * boost::filesystem::path::operator/ and made preferred
+ */
+void buildPath( const BrowseItem &item, string &path )
+{
+	path = item.path.string();
+	if( item.type == SEQUENCE )
+	{
+		const SequencePattern &pattern = item.sequence.pattern;
+		if( !path.empty() && !isSeparator( path[path.size() - 1] ) && ( pattern.prefix.empty() || !isSeparator( pattern.prefix[0] ) ) )
+			path += boost::filesystem::path::preferred_separator;
+		path += pattern.prefix;
+		path.append( pattern.padding == 0 ? 1 : pattern.padding, gPaddingChar );
+		path += pattern.suffix;
+	}
+#ifdef BOOST_WINDOWS_API
+	std::replace( path.begin(), path.end(), '/', '\\' );
+#endif
+}
+
+}
+
+ItemWriter::ItemWriter( FILE *file, OutputFormat format, size_t bufferSize ) :
+	file( file ),
+	format( format ),
+	buffer( max( bufferSize, size_t( 256 ) ) ),
+	used( 0 )
+{
+}
+
+ItemWriter::~ItemWriter()
+{
+	try
+	{
+		flush();
+	}
+	catch( ... )
+	{
+	}
+}
+
+void ItemWriter::flush()
+{
+	if( used && fwrite( &buffer[0], 1, used, file ) != used )
+	{
+		used = 0;
+		throw runtime_error( "Unable to write items" );
+	}
+	used = 0;
+	fflush( file );
+}
+
+inline void ItemWriter::append( char c )
+{
+	if( used == buffer.size() )
+		flush();
+	buffer[used++] = c;
+}
+
+void ItemWriter::append( const char* data, size_t size )
+{
+	while( size )
+	{
+		if( used == buffer.size() )
+			flush();
+		const size_t chunk = min( size, buffer.size() - used );
+		memcpy( &buffer[used], data, chunk );
+		used += chunk;
+		data += chunk;
+		size -= chunk;
+	}
+}
+
+void ItemWriter::append( const string &value )
+{
+	append( value.data(), value.size() );
+}
+
+void ItemWriter::appendNumber( unsigned int value )
+{
+	char digits[16];
+	char* end = digits + sizeof( digits );
+	char* begin = end;
+	do
+	{
+		*--begin = '0' + value % 10;
+		value /= 10;
+	} while( value );
+	append( begin, end - begin );
+}
+
+// same quoting as boost::filesystem::path's operator<<
+void ItemWriter::appendQuoted( const string &value )
+{
+	append( '"' );
+	for( string::const_iterator itr = value.begin(); itr != value.end(); ++itr )
+	{
+		if( *itr == '"' || *itr == '&' )
+			append( '&' );
+		append( *itr );
+	}
+	append( '"' );
+}
+
+void ItemWriter::appendJson( const string &value )
+{
+	static const char hex[] = "0123456789abcdef";
+	append( '"' );
+	for( string::const_iterator itr = value.begin(); itr != value.end(); ++itr )
+	{
+		const unsigned char c = *itr;
+		if( c == '"' || c == '\\' )
+		{
+			append( '\\' );
+			append( c );
+		}
+		else if( c < 0x20 )
+		{
+			const char escaped[] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+			append( escaped, sizeof( escaped ) );
+		}
+		else
+			append( c );
+	}
+	append( '"' );
+}
+
+void ItemWriter::writePlain( const BrowseItem &item )
+{
+	append( toString( item.type ) );
+	append( ' ' );
+	buildPath( item, path );
+	appendQuoted( path );
+	if( item.type == SEQUENCE )
+	{
+		const Sequence &sequence = item.sequence;
+		append( " [", 2 );
+		appendNumber( sequence.range.first );
+		append( ':' );
+		appendNumber( sequence.range.last );
+		append( ']' );
+		if( sequence.step > 1 )
+		{
+			append( " (", 2 );
+			appendNumber( sequence.step );
+			append( ')' );
+		}
+	}
+}
+
+void ItemWriter::writeJson( const BrowseItem &item )
+{
+	append( "{\"type\":\"", 9 );
+	append( toString( item.type ) );
+	append( "\",\"path\":", 9 );
+	buildPath( item, path );
+	appendJson( path );
+	if( item.type == SEQUENCE )
+	{
+		const Sequence &sequence = item.sequence;
+		append( ",\"directory\":", 13 );
+		appendJson( item.path.string() );
+		append( ",\"prefix\":", 10 );
+		appendJson( sequence.pattern.prefix );
+		append( ",\"suffix\":", 10 );
+		appendJson( sequence.pattern.suffix );
+		append( ",\"padding\":", 11 );
+		appendNumber( sequence.pattern.padding );
+		append( ",\"first\":", 9 );
+		appendNumber( sequence.range.first );
+		append( ",\"last\":", 8 );
+		appendNumber( sequence.range.last );
+		append( ",\"step\":", 8 );
+		appendNumber( sequence.step );
+	}
+	append( '}' );
+}
+
+void ItemWriter::write( const BrowseItem &item )
+{
+	switch( format )
+	{
+		case FORMAT_PLAIN:
+			writePlain( item );
+			append( '\n' );
+			break;
+		case FORMAT_JSON:
+			writeJson( item );
+			append( '\n' );
+			break;
+		case FORMAT_NUL:
+			buildPath( item, path );
+			append( path );
+			append( '\0' );
+			break;
+	}
+}
+
+}
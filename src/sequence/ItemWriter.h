@@ -0,0 +1,69 @@
+#ifndef ITEMWRITER_H_
+#define ITEMWRITER_H_
+
+#include "Config.h"
+#include "BrowseItem.h"
+
+#include <boost/noncopyable.hpp>
+
+#include <cstdio>
+#include <vector>
+
+namespace sequence
+{
+
+/**
+ * How ItemWriter formats the items
+ */
+enum OutputFormat
+{
+	FORMAT_PLAIN, ///< one item per line, as operator<<( ostream&, const BrowseItem& ) does
+	FORMAT_JSON,  ///< one JSON object per line
+	FORMAT_NUL    ///< the bare path, or padded pattern of a sequence, ended with '\0' as xargs -0 reads it
+};
+
+/**
+ * Formats items straight into a buffer flushed to a FILE when full, with
+ * no stream nor temporary string per item.
+ *
+ * JSON strings are escaped but not validated : non UTF-8 filenames are
+ * written as is.
+ */
+class SEQUENCEPARSER_API ItemWriter : boost::noncopyable
+{
+public:
+	ItemWriter( std::FILE *file, OutputFormat format = FORMAT_PLAIN, size_t bufferSize = 64 * 1024 );
+
+	~ItemWriter();
+
+	void write( const BrowseItem &item );
+
+	template<typename Iterator>
+	void write( Iterator begin, const Iterator end )
+	{
+		for( ; begin != end; ++begin )
+			write( *begin );
+	}
+
+	void flush();
+
+private:
+	void append( const char* data, size_t size );
+	void append( const std::string &value );
+	void append( char c );
+	void appendNumber( unsigned int value );
+	void appendQuoted( const std::string &value );
+	void appendJson( const std::string &value );
+	void writePlain( const BrowseItem &item );
+	void writeJson( const BrowseItem &item );
+
+	std::FILE *file;
+	OutputFormat format;
+	std::vector<char> buffer;
+	size_t used;
+	std::string path; ///< reused to build the paths
+};
+
+}
+
+#endif
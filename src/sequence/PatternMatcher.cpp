@@ -0,0 +1,124 @@
+#include "PatternMatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+namespace sequence {
+
+namespace {
+
+/**
+ * Compares 16 bytes at a time. Names are short so calling memcmp costs
+ * more than the comparison itself.
+ */
+inline bool equalBytes( const char* a, const char* b, size_t size )
+{
+#ifdef __SSE2__
+	for( ; size >= 16; size -= 16, a += 16, b += 16 )
+	{
+		const __m128i va = _mm_loadu_si128( reinterpret_cast<const __m128i*>( a ) );
+		const __m128i vb = _mm_loadu_si128( reinterpret_cast<const __m128i*>( b ) );
+		if( _mm_movemask_epi8( _mm_cmpeq_epi8( va, vb ) ) != 0xFFFF )
+			return false;
+	}
+#endif
+	for( ; size; --size, ++a, ++b )
+		if( *a != *b )
+			return false;
+	return true;
+}
+
+}
+
+PatternMatcher::PatternMatcher( const SequencePattern &pattern ) :
+	pattern( pattern ),
+	minSize( pattern.prefix.size() + max( size_t( 1 ), size_t( pattern.padding ) ) + pattern.suffix.size() )
+{
+}
+
+bool PatternMatcher::match( const char* filename, size_t size, unsigned int &frame ) const
+{
+	if( size < minSize )
+		return false;
+	const size_t prefixSize = pattern.prefix.size();
+	const size_t suffixSize = pattern.suffix.size();
+	const size_t digits = size - prefixSize - suffixSize;
+	// the frame must be padded to the width as instanciatePattern does, wider
+	// frames being written as is the way printf( "%04d" ) does
+	if( digits > max( size_t( 1 ), size_t( pattern.padding ) ) && filename[prefixSize] == '0' )
+		return false;
+	if( digits > numeric_limits<unsigned int>::digits10 + 1 )
+		return false;
+	if( !equalBytes( filename, pattern.prefix.data(), prefixSize ) ||
+		!equalBytes( filename + size - suffixSize, pattern.suffix.data(), suffixSize ) )
+		return false;
+	unsigned long long value = 0;
+	for( const char* itr = filename + prefixSize, *end = itr + digits; itr != end; ++itr )
+	{
+		const unsigned int digit = static_cast<unsigned char>( *itr ) - '0';
+		if( digit > 9 )
+			return false;
+		value = value * 10 + digit;
+	}
+	if( value > numeric_limits<unsigned int>::max() )
+		return false;
+	frame = static_cast<unsigned int>( value );
+	return true;
+}
+
+size_t PatternMatcher::matchBlock( const char* begin, const char* end, char separator, vector<unsigned int> &frames ) const
+{
+	size_t matches = 0;
+	unsigned int frame;
+	while( begin < end )
+	{
+		const char* found = static_cast<const char*>( memchr( begin, separator, end - begin ) );
+		const char* filenameEnd = found ? found : end;
+		if( match( begin, filenameEnd - begin, frame ) )
+		{
+			frames.push_back( frame );
+			++matches;
+		}
+		begin = filenameEnd + 1;
+	}
+	return matches;
+}
+
+size_t PatternMatcher::match( const vector<string> &filenames, vector<unsigned int> &frames ) const
+{
+	size_t matches = 0;
+	unsigned int frame;
+	for( vector<string>::const_iterator itr = filenames.begin(); itr != filenames.end(); ++itr )
+	{
+		if( match( *itr, frame ) )
+		{
+			frames.push_back( frame );
+			++matches;
+		}
+	}
+	return matches;
+}
+
+vector<unsigned int> missingFrames( const Sequence &expected, vector<unsigned int> frames )
+{
+	sort( frames.begin(), frames.end() );
+	vector<unsigned int> missing;
+	const unsigned int step = max( static_cast<unsigned short>( 1 ), expected.step );
+	vector<unsigned int>::const_iterator found = frames.begin();
+	for( unsigned long long frame = expected.range.first; frame <= expected.range.last; frame += step )
+	{
+		found = lower_bound( found, static_cast<vector<unsigned int>::const_iterator>( frames.end() ), static_cast<unsigned int>( frame ) );
+		if( found == frames.end() || *found != frame )
+			missing.push_back( static_cast<unsigned int>( frame ) );
+	}
+	return missing;
+}
+
+}
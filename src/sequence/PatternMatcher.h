@@ -0,0 +1,54 @@
+#ifndef PATTERNMATCHER_H_
+#define PATTERNMATCHER_H_
+
+#include "Config.h"
+#include "Sequence.h"
+
+#include <string>
+#include <vector>
+
+namespace sequence
+{
+
+/**
+ * Matches filenames against a SequencePattern and extracts their frame.
+ * A filename matches if it is the prefix, a frame written as
+ * instanciatePattern() would write it, then the suffix. Frames wider than
+ * the padding match when they have no leading zero.
+ *
+ * The pattern is referenced, not copied : it must outlive the matcher.
+ */
+class SEQUENCEPARSER_API PatternMatcher
+{
+public:
+	explicit PatternMatcher( const SequencePattern &pattern );
+
+	bool match( const char* filename, size_t size, unsigned int &frame ) const;
+
+	bool match( const std::string &filename, unsigned int &frame ) const
+	{
+		return match( filename.data(), filename.size(), frame );
+	}
+
+	/**
+	 * Matches each 'separator' terminated filename of [begin, end), the last
+	 * one may be unterminated. Frames of the matching ones are appended to
+	 * 'frames', the number of matches is returned.
+	 */
+	size_t matchBlock( const char* begin, const char* end, char separator, std::vector<unsigned int> &frames ) const;
+
+	size_t match( const std::vector<std::string> &filenames, std::vector<unsigned int> &frames ) const;
+
+private:
+	const SequencePattern &pattern;
+	size_t minSize;
+};
+
+/**
+ * The frames of 'expected' not present in 'frames', in increasing order
+ */
+SEQUENCEPARSER_API std::vector<unsigned int> missingFrames( const Sequence &expected, std::vector<unsigned int> frames );
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "Range.h"
-#include <boost/rational.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <climits>
@@ -16,25 +17,84 @@ Range Range::weak( unsigned int first, unsigned int count )
 	return Range( first, first + count - 1 );
 }
 
+namespace
+{
+
+/**
+ * The source frame is source.first + recOffset * srcDuration / recDuration
+ * rounded down, durations being inclusive when the record is longer.
+ * Products fit in 64 bits as both factors are below 2^32 + 1.
+ */
+struct Interpolation
+{
+	Interpolation( const Range &source, const Range &record ) :
+		first( source.first ),
+		recDuration( boost::uint64_t( record.last ) - record.first ),
+		srcDuration( boost::uint64_t( source.last ) - source.first )
+	{
+		assert( source.valid() );
+		assert( record.valid() );
+		if( recDuration > srcDuration )
+		{
+			++recDuration;
+			++srcDuration;
+		}
+	}
+
+	unsigned int operator()( boost::uint64_t recOffset ) const
+	{
+		if( recDuration == 0 )
+			return first;
+		return static_cast<unsigned int>( first + recOffset * srcDuration / recDuration );
+	}
+
+	unsigned int first;
+	boost::uint64_t recDuration;
+	boost::uint64_t srcDuration;
+};
+
+}
+
 unsigned int interpolateSource( const unsigned int recFrame, const Range &source, const Range &record, const bool reverse )
 {
-	assert(source.valid());
-	assert(record.valid());
 	assert(record.contains(recFrame));
+	const Interpolation interpolation( source, record );
+	return interpolation( reverse ? record.last - recFrame : recFrame - record.first );
+}
 
-	typedef boost::rational<int64_t> Rational;
-	Rational recDuration = record.last - record.first;
-	Rational srcDuration = source.last - source.first;
-
-	if( recDuration > srcDuration )
+void interpolateSources( const Range &source, const Range &record, const bool reverse, unsigned int *output )
+{
+	const Interpolation interpolation( source, record );
+	const size_t count = size_t( record.last - record.first ) + 1;
+	if( interpolation.recDuration == 0 )
 	{
-		++recDuration;
-		++srcDuration;
+		fill( output, output + count, interpolation.first );
+		return;
 	}
-	const Rational recOffset = reverse ? record.last - recFrame : recFrame - record.first;
-	const Rational srcOffset = recDuration == 0 ? 0 : ( recOffset * srcDuration / recDuration );
-	const Rational srcFrame  = srcOffset + source.first;
-	return boost::rational_cast<unsigned int>( srcFrame );
+	// offsets grow by one : the quotient and remainder are updated
+	// incrementally instead of dividing for each frame
+	const boost::uint64_t quotientStep  = interpolation.srcDuration / interpolation.recDuration;
+	const boost::uint64_t remainderStep = interpolation.srcDuration % interpolation.recDuration;
+	boost::uint64_t quotient  = interpolation.first;
+	boost::uint64_t remainder = 0;
+	for( size_t i = 0; i < count; ++i )
+	{
+		output[i] = static_cast<unsigned int>( quotient );
+		quotient  += quotientStep;
+		remainder += remainderStep;
+		const bool carry = remainder >= interpolation.recDuration;
+		quotient  += carry;
+		remainder -= carry ? interpolation.recDuration : 0;
+	}
+	if( reverse )
+		std::reverse( output, output + count );
+}
+
+std::vector<unsigned int> interpolateSources( const Range &source, const Range &record, const bool reverse )
+{
+	std::vector<unsigned int> frames( size_t( record.last - record.first ) + 1 );
+	interpolateSources( source, record, reverse, &frames[0] );
+	return frames;
 }
 
 unsigned int Range::duration() const
@@ -44,55 +104,80 @@ unsigned int Range::duration() const
 	return last - first + 1;
 }
 
-static inline unsigned int loopReducedOffset( const Range &range, int32_t offset )
+namespace
 {
-	assert( range.valid() );
-	const bool forward = offset > 0;
-	const unsigned int positiveOffset = forward ? offset : -offset;
-	return positiveOffset % range.duration();
-}
 
-template<bool isCycling>
-static inline Range::MoveResult offsetFrame( const Range &range, unsigned int current, int offset )
+// branch free kernels, 64 bits arithmetic can't overflow
+inline unsigned int clampKernel( const boost::int64_t first, const boost::int64_t last, const unsigned int current, const int offset, bool &moved )
 {
-	assert( range.valid() );
-	assert( range.contains( current ) );
-
-	if ( offset == 0 )
-		return make_pair( current, false );
-
-	// offset frame is within [first,last]
-	const bool forward = offset > 0;
-	const uint32_t positiveOffset    = forward ? offset : -offset;
-	const uint32_t distanceToLast    = Range( current, range.last ).duration();
-	const uint32_t distanceToFirst   = Range( range.first, current ).duration();
-	const uint32_t semiRangeDuration = forward ? distanceToLast : distanceToFirst;
+	const boost::int64_t target = boost::int64_t( current ) + offset;
+	moved = ( target < first ) | ( target > last );
+	const boost::int64_t low = target < first ? first : target;
+	return static_cast<unsigned int>( low > last ? last : low );
+}
 
-	// inside
-	if( positiveOffset < semiRangeDuration )
-		return make_pair( forward ? current + positiveOffset : current - positiveOffset, false );
+inline unsigned int loopKernel( const boost::int64_t first, const boost::int64_t duration, const unsigned int current, const int offset, bool &moved )
+{
+	const boost::int64_t relative = boost::int64_t( current ) - first;
+	const boost::int64_t target = relative + offset;
+	moved = ( target < 0 ) | ( target >= duration );
+	// within ]-duration, 2 * duration[ once the offset is reduced, the
+	// division is only needed for offsets longer than the range
+	const bool small = ( offset < duration ) & ( -boost::int64_t( offset ) < duration );
+	const boost::int64_t reduced = relative + ( small ? offset : offset % duration );
+	const boost::int64_t wrapped = reduced + ( reduced < 0 ) * duration - ( reduced >= duration ) * duration;
+	return static_cast<unsigned int>( first + wrapped );
+}
 
-	if( isCycling )
+template<bool isCycling, bool withMoved>
+inline void offsetFrames( const Range &range, const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved )
+{
+	assert( range.valid() );
+	const boost::int64_t first = range.first;
+	const boost::int64_t last = range.last;
+	const boost::int64_t duration = last - first + 1;
+	bool dummy;
+	for( size_t i = 0; i < count; ++i )
 	{
-		const unsigned int reduced = loopReducedOffset( range, offset );
-		if ( reduced == 0 )
-			return make_pair( current, true );
-		return make_pair( forward ? range.first + reduced - distanceToLast : range.last - reduced + distanceToFirst, true );
+		assert( range.contains( current[i] ) );
+		bool &flag = withMoved ? moved[i] : dummy;
+		frames[i] = isCycling ? loopKernel( first, duration, current[i], offsets[i], flag ) : clampKernel( first, last, current[i], offsets[i], flag );
 	}
+}
+
+template<bool isCycling>
+inline void offsetFrames( const Range &range, const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved )
+{
+	if( moved )
+		offsetFrames<isCycling, true>( range, current, offsets, count, frames, moved );
 	else
-	{
-		return make_pair( forward ? range.last : range.first, true );
-	}
+		offsetFrames<isCycling, false>( range, current, offsets, count, frames, moved );
+}
+
 }
 
 Range::MoveResult Range::offsetClampFrame( unsigned int current, int offset ) const
 {
-	return offsetFrame<false>( *this, current, offset );
+	MoveResult result;
+	offsetFrames<false, true>( *this, &current, &offset, 1, &result.first, &result.second );
+	return result;
 }
 
 Range::MoveResult Range::offsetLoopFrame( unsigned int current, int offset ) const
 {
-	return offsetFrame<true>( *this, current, offset );
+	MoveResult result;
+	offsetFrames<true, true>( *this, &current, &offset, 1, &result.first, &result.second );
+	return result;
+}
+
+void Range::offsetClampFrames( const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved ) const
+{
+	offsetFrames<false>( *this, current, offsets, count, frames, moved );
+}
+
+void Range::offsetLoopFrames( const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved ) const
+{
+	offsetFrames<true>( *this, current, offsets, count, frames, moved );
 }
 
 unsigned int Range::clampFrame( unsigned int current ) const
@@ -4,6 +4,7 @@
 #include "Config.h"
 
 #include <stdexcept>
+#include <vector>
 
 namespace sequence
 {
@@ -46,11 +47,27 @@ struct SEQUENCEPARSER_API Range {
 
 	MoveResult offsetClampFrame( unsigned int current, int offset ) const;
 	MoveResult offsetLoopFrame( unsigned int current, int offset ) const;
+
+	/**
+	 * offsetClampFrame() and offsetLoopFrame() for 'count' frames at once :
+	 * frames[i] and moved[i] receive the result for current[i] and offsets[i].
+	 * 'moved' may be NULL.
+	 */
+	void offsetClampFrames( const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved = NULL ) const;
+	void offsetLoopFrames( const unsigned int *current, const int *offsets, size_t count, unsigned int *frames, bool *moved = NULL ) const;
 	unsigned int clampFrame( unsigned int current ) const;
 };
 
 SEQUENCEPARSER_API unsigned int interpolateSource( const unsigned int atRecIndex, const Range &source, const Range &record, const bool reverse );
 
+/**
+ * interpolateSource() for every frame of 'record', in increasing record
+ * order. 'output' must hold record.duration() frames.
+ */
+SEQUENCEPARSER_API void interpolateSources( const Range &source, const Range &record, const bool reverse, unsigned int *output );
+
+SEQUENCEPARSER_API std::vector<unsigned int> interpolateSources( const Range &source, const Range &record, const bool reverse );
+
 }
 
 #endif
@@ -1,5 +1,6 @@
 #include "Sequence.h"
 #include "DisplayUtils.h"
+#include "PatternMatcher.h"
 
 #include <algorithm>
 #include <sstream>
@@ -9,7 +10,8 @@ using namespace std;
 namespace sequence {
 
 bool SequencePattern::match(const std::string &filename) const {
-    return equal(prefix.begin(), prefix.end(), filename.begin()) && equal(suffix.rbegin(), suffix.rend(), filename.rbegin());
+    unsigned int frame;
+    return PatternMatcher(*this).match(filename, frame);
 }
 
 string SequencePattern::string() const{
@@ -5,9 +5,11 @@
 #include "Range.h"
 
 #include <boost/filesystem/path.hpp>
+#include <boost/cstdint.hpp>
 
 #include <string>
 #include <utility>
+#include <ctime>
 #include <cassert>
 
 namespace sequence
@@ -31,6 +33,10 @@ struct SEQUENCEPARSER_API SequencePattern
 		padding( padding )
 	{}
 
+	/**
+	 * Whether 'filename' is the prefix, a frame written as instanciatePattern()
+	 * would write it, then the suffix
+	 */
 	bool match( const std::string &filename ) const;
 
 	std::string string() const;
@@ -41,11 +47,47 @@ struct SEQUENCEPARSER_API SequencePattern
 	}
 };
 
+/**
+ * Aggregated on-disk information about the files of a Sequence.
+ * Only filled when explicitly requested ( see parser::gatherMetadata ),
+ * it is not taken into account when comparing Sequences.
+ */
+struct SEQUENCEPARSER_API Metadata
+{
+	boost::uintmax_t size; ///< total size in bytes
+	std::time_t minTime;   ///< oldest modification time
+	std::time_t maxTime;   ///< newest modification time
+	unsigned int count;    ///< number of files successfully stat'ed
+
+	Metadata() :
+		size( 0 ),
+		minTime( 0 ),
+		maxTime( 0 ),
+		count( 0 )
+	{}
+
+	void add( boost::uintmax_t fileSize, std::time_t modificationTime )
+	{
+		size += fileSize;
+		if( count == 0 || modificationTime < minTime )
+			minTime = modificationTime;
+		if( count == 0 || modificationTime > maxTime )
+			maxTime = modificationTime;
+		++count;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+};
+
 struct SEQUENCEPARSER_API Sequence
 {
 	SequencePattern pattern;
 	Range range;
 	unsigned short step;
+	Metadata metadata;
 
 	Sequence() :
 		step( 1 )
@@ -72,7 +114,8 @@ namespace details {
 template<size_t count=32>
 struct CharStack
 {
-	CharStack( unsigned int value ) :
+	template<typename T>
+	CharStack( T value ) :
 		index( 0 )
 	{
 		for( ; value; value /= 10 )
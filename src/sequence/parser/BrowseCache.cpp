@@ -0,0 +1,204 @@
+#include "BrowseCache.h"
+#include "Metadata.h"
+#include "NaturalSort.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+using namespace std;
+using namespace boost::filesystem;
+
+namespace sequence {
+namespace parser {
+
+/**
+ * A listing is only cached if its directory was modified at least that many
+ * seconds before, leaving room for coarse or skewed file system clocks
+ */
+static const time_t gRacyDelay = 2;
+
+static time_t currentTime()
+{
+	return time( NULL );
+}
+
+/**
+ * Records the identity of 'directory' as Walker does, returns false if it
+ * was already visited
+ */
+static bool firstVisit( DirectoryIds &visited, const path &directory )
+{
+#ifdef _WIN32
+	boost::system::error_code error;
+	const path identity = canonical( directory, error );
+	if( error )
+		return true;
+	return visited.insert( make_pair( boost::uint64_t( 0 ), boost::uint64_t( boost::hash_value( identity.string() ) ) ) ).second;
+#else
+	struct stat buffer;
+	if( ::stat( directory.string().c_str(), &buffer ) != 0 )
+		return true; // listing it reports the error
+	return visited.insert( make_pair( boost::uint64_t( buffer.st_dev ), boost::uint64_t( buffer.st_ino ) ) ).second;
+#endif
+}
+
+struct BrowseCache::Shard
+{
+	typedef boost::unordered_map<string, CachedListingPtr> Listings;
+	Listings listings;
+	BrowseCacheCounters counters;
+	boost::mutex mutex;
+
+	/**
+	 * Drops the listings that outlived 'ttl', or the oldest one if none did
+	 */
+	void makeRoom( unsigned ttl, time_t now )
+	{
+		const size_t before = listings.size();
+		Listings::iterator oldest = listings.end();
+		for( Listings::iterator itr = listings.begin(); itr != listings.end(); )
+		{
+			if( ttl && now >= itr->second->listed + time_t( ttl ) )
+			{
+				itr = listings.erase( itr );
+				continue;
+			}
+			if( oldest == listings.end() || itr->second->listed < oldest->second->listed )
+				oldest = itr;
+			++itr;
+		}
+		if( listings.size() == before && oldest != listings.end() )
+			listings.erase( oldest );
+		counters.evicted += before - listings.size();
+	}
+};
+
+BrowseCache::BrowseCache( const BrowseOptions &options, unsigned ttl, size_t shards, size_t capacity, Clock clock ) :
+	options( options ),
+	ttl( ttl ),
+	shardCount( max( size_t( 1 ), shards ) ),
+	shardCapacity( capacity ? max( size_t( 1 ), ( capacity + shardCount - 1 ) / shardCount ) : 0 ),
+	clock( clock ? clock : &currentTime ),
+	table( new Shard[shardCount] )
+{
+	this->options.recursive = false;
+	this->options.gatherMetadata = false;
+	this->options.sorted = false;
+	this->options.statistics = NULL;
+}
+
+BrowseCache::~BrowseCache()
+{
+}
+
+CachedListingPtr BrowseCache::listing( const path &directory )
+{
+	const string &key = directory.string();
+	Shard &shard = table[boost::hash<string>()( key ) % shardCount];
+	struct stat buffer;
+	const bool known = ::stat( key.c_str(), &buffer ) == 0;
+	const time_t now = clock();
+	{
+		boost::lock_guard<boost::mutex> lock( shard.mutex );
+		const Shard::Listings::const_iterator found = shard.listings.find( key );
+		if( known && found != shard.listings.end() && found->second->modified == buffer.st_mtime )
+		{
+			if( !ttl || now < found->second->listed + time_t( ttl ) )
+			{
+				++shard.counters.hits;
+				return found->second;
+			}
+			++shard.counters.expired;
+		}
+		++shard.counters.misses;
+	}
+	const boost::shared_ptr<CachedListing> listing = boost::make_shared<CachedListing>();
+	listing->modified = known ? buffer.st_mtime : 0;
+	listing->listed = now;
+	listing->device = known ? buffer.st_dev : 0;
+	listing->inode = known ? buffer.st_ino : 0;
+	listing->items = browseDirectory( key.c_str(), options, listing->subdirectories );
+	boost::lock_guard<boost::mutex> lock( shard.mutex );
+	if( known && listing->modified + gRacyDelay <= now )
+	{
+		if( shardCapacity && shard.listings.size() >= shardCapacity && !shard.listings.count( key ) )
+			shard.makeRoom( ttl, now );
+		shard.listings[key] = listing;
+	}
+	else
+		shard.listings.erase( key );
+	return listing;
+}
+
+vector<CachedListingPtr> BrowseCache::listings( const path &directory, bool recursive )
+{
+	vector<CachedListingPtr> result;
+	DirectoryIds visited;
+	if( options.followSymlinks )
+		firstVisit( visited, directory );
+	vector<path> pending( 1, directory );
+	while( !pending.empty() )
+	{
+		const path current = pending.back();
+		pending.pop_back();
+		result.push_back( listing( current ) );
+		if( !recursive )
+			break;
+		// pushed backward so directories are visited in listing order
+		const vector<path> &subdirectories = result.back()->subdirectories;
+		for( vector<path>::const_reverse_iterator itr = subdirectories.rbegin(); itr != subdirectories.rend(); ++itr )
+			if( !options.followSymlinks || firstVisit( visited, *itr ) )
+				pending.push_back( *itr );
+	}
+	return result;
+}
+
+BrowseItems BrowseCache::browse( const char* directory, const BrowseOptions &browseOptions )
+{
+	const vector<CachedListingPtr> found = listings( path( directory == NULL ? "." : directory ), browseOptions.recursive );
+	BrowseItems items;
+	for( vector<CachedListingPtr>::const_iterator itr = found.begin(); itr != found.end(); ++itr )
+		items.insert( items.end(), ( *itr )->items.begin(), ( *itr )->items.end() );
+	if( browseOptions.gatherMetadata )
+		gatherMetadata( items );
+	if( browseOptions.sorted )
+		sortItems( items );
+	return items;
+}
+
+void BrowseCache::clear()
+{
+	for( size_t i = 0; i < shardCount; ++i )
+	{
+		boost::lock_guard<boost::mutex> lock( table[i].mutex );
+		table[i].listings.clear();
+	}
+}
+
+BrowseCacheCounters BrowseCache::counters() const
+{
+	BrowseCacheCounters result;
+	for( size_t i = 0; i < shardCount; ++i )
+	{
+		boost::lock_guard<boost::mutex> lock( table[i].mutex );
+		result.hits += table[i].counters.hits;
+		result.misses += table[i].counters.misses;
+		result.expired += table[i].counters.expired;
+		result.evicted += table[i].counters.evicted;
+		result.directories += table[i].listings.size();
+	}
+	return result;
+}
+
+}
+}
@@ -0,0 +1,136 @@
+/*
+ * BrowseCache.h
+ *
+ * In process cache of directory listings, shared by threads.
+ */
+
+#ifndef BROWSECACHE_H_
+#define BROWSECACHE_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <ctime>
+#include <vector>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * Content of a single directory, as it was when its modification time was 'modified'
+ */
+struct SEQUENCEPARSER_API CachedListing
+{
+	time_t modified;
+	time_t listed;          ///< when it was listed
+	boost::uint64_t device; ///< with inode, identifies the directory whatever its path
+	boost::uint64_t inode;
+	BrowseItems items;
+	std::vector<boost::filesystem::path> subdirectories;
+};
+
+typedef boost::shared_ptr<const CachedListing> CachedListingPtr;
+
+/**
+ * Counters of a BrowseCache
+ */
+struct SEQUENCEPARSER_API BrowseCacheCounters
+{
+	boost::uint64_t hits;        ///< directories served from the cache
+	boost::uint64_t misses;      ///< directories listed on disk, expired ones included
+	boost::uint64_t expired;     ///< directories listed again because their listing outlived the ttl
+	boost::uint64_t evicted;     ///< listings dropped to make room for others
+	boost::uint64_t directories; ///< directories currently cached
+
+	BrowseCacheCounters() :
+		hits( 0 ),
+		misses( 0 ),
+		expired( 0 ),
+		evicted( 0 ),
+		directories( 0 )
+	{}
+};
+
+/**
+ * Listings cached per directory, safe to use from any number of threads.
+ *
+ * A directory is listed again when its modification time changes, which
+ * happens whenever an entry is added, removed or renamed, or when its
+ * listing is older than 'ttl' seconds. A directory modified in the seconds
+ * preceding its listing is not cached since a later change could leave its
+ * time untouched. Directories are keyed by their path as given.
+ *
+ * The cache is split in 'shards', each one with its own lock held only
+ * while looking up or storing a listing, never while listing. Threads
+ * missing the same directory at the same time all list it.
+ *
+ * Each shard holds at most its share of 'capacity' listings. Storing a
+ * listing in a full shard first drops the listings that outlived the ttl,
+ * or if none did the one listed the longest ago.
+ */
+class SEQUENCEPARSER_API BrowseCache : boost::noncopyable
+{
+public:
+	/**
+	 * The current time, as time( NULL ) returns it
+	 */
+	typedef time_t (*Clock)();
+
+	/**
+	 * Directories are listed with 'options', whose recursive,
+	 * gatherMetadata, sorted and statistics fields are ignored.
+	 * A 'ttl' of 0 keeps listings as long as their directory is unchanged.
+	 * A 'capacity' of 0 puts no bound on the number of listings.
+	 * 'clock' replaces time( NULL ), letting tests move time forward.
+	 */
+	explicit BrowseCache( const BrowseOptions &options = BrowseOptions(), unsigned ttl = 0, size_t shards = 16, size_t capacity = 1 << 16, Clock clock = NULL );
+	~BrowseCache();
+
+	/**
+	 * The listing of a single directory
+	 * Throws std::ios_base::failure if it can't be listed
+	 */
+	CachedListingPtr listing( const boost::filesystem::path &directory );
+
+	/**
+	 * The listings of 'directory' and, if 'recursive', of its sub directories
+	 * in the order Walker visits them, each physical directory once if the
+	 * cache follows symbolic links
+	 */
+	std::vector<CachedListingPtr> listings( const boost::filesystem::path &directory, bool recursive );
+
+	/**
+	 * The items parser::browse( directory, options ) finds, directory by
+	 * directory as Walker returns them, directories being taken from the
+	 * cache. Only the recursive, gatherMetadata and sorted options are
+	 * used, metadata being gathered for every call as modifying a file
+	 * does not touch its directory.
+	 */
+	BrowseItems browse( const char* directory, const BrowseOptions &options = BrowseOptions() );
+
+	void clear();
+
+	BrowseCacheCounters counters() const;
+
+private:
+	struct Shard;
+	BrowseOptions options;
+	const unsigned ttl;
+	const size_t shardCount;
+	const size_t shardCapacity;
+	const Clock clock;
+	boost::scoped_array<Shard> table;
+};
+
+}
+}
+
+#endif
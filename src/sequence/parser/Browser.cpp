@@ -1,9 +1,19 @@
 #include "Browser.h"
+#include "Metadata.h"
+#include "NaturalSort.h"
+#include "Statistics.h"
+#include "Walker.h"
 #include "details/Utils.h"
 
 #include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/thread.hpp>
 #include <boost/unordered_map.hpp>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <string>
 #include <stdexcept>
 
@@ -22,44 +32,342 @@ static inline path getDirectory(const char* directory) {
 	return folder;
 }
 
-static inline void changeTypeIfNeeded(BrowseItem &item) {
-	if (item.type == UNITFILE && is_directory(item.path))
-		item.type = FOLDER;
+/**
+ * Returns the number of is_directory calls
+ */
+static size_t changeTypesIfNeeded( BrowseItems &items )
+{
+	size_t calls = 0;
+	for( BrowseItems::iterator itr = items.begin(); itr != items.end(); ++itr )
+	{
+		if( itr->type != UNITFILE )
+			continue;
+		++calls;
+		if( is_directory( itr->path ) )
+			itr->type = FOLDER;
+	}
+	return calls;
+}
+
+static inline void countSyscalls( Statistics *statistics, size_t calls )
+{
+	if( statistics )
+		statistics->syscalls += calls;
+}
+
+/**
+ * An estimation of the number of entries of 'folder', 0 if unknown.
+ * Common file systems use a few tens of bytes per directory entry.
+ */
+static size_t entriesHint( const path &folder )
+{
+	struct stat buffer;
+	if( ::stat( folder.string().c_str(), &buffer ) != 0 )
+		return 0;
+	return buffer.st_size / 32;
+}
+
+/**
+ * entriesHint( folder ) if 'presize' is set, 0 otherwise
+ */
+static size_t presizeHint( const path &folder, bool presize, Statistics *statistics )
+{
+	if( !presize )
+		return 0;
+	countSyscalls( statistics, 1 );
+	return entriesHint( folder );
+}
+
+/**
+ * Records the identity of 'directory', returns false if it was already
+ * visited, under this path or another one
+ */
+static bool firstVisit( DirectoryIds &visited, const path &directory, Statistics *statistics )
+{
+	countSyscalls( statistics, 1 );
+#ifdef _WIN32
+	// stat gives no inode number, the canonical path identifies the directory instead
+	boost::system::error_code error;
+	const path identity = canonical( directory, error );
+	if( error )
+		return true; // listing it reports the error
+	return visited.insert( make_pair( boost::uint64_t( 0 ), boost::uint64_t( boost::hash_value( identity.string() ) ) ) ).second;
+#else
+	struct stat buffer;
+	if( ::stat( directory.string().c_str(), &buffer ) != 0 )
+		return true; // listing it reports the error
+	return visited.insert( make_pair( boost::uint64_t( buffer.st_dev ), boost::uint64_t( buffer.st_ino ) ) ).second;
+#endif
 }
 
 struct SEQUENCEPARSER_LOCAL Proxy
 {
-	Proxy( Parser& parser ) :
-		parser( parser )
+	Proxy( Parser& parser, vector<path> *subdirectories = NULL, size_t hint = 0, bool followSymlinks = false, Statistics *statistics = NULL ) :
+		parser( parser ),
+		subdirectories( subdirectories ),
+		hint( hint ),
+		followSymlinks( followSymlinks ),
+		statistics( statistics )
 	{
 	}
-	void operator()( const boost::filesystem::path &path )
+	/**
+	 * Presizes 'directory' with the next entry, if it belongs to it
+	 */
+	void hintNext( const path &directory, size_t entries )
 	{
-		parser.insert( path.string() );
+		hinted = directory;
+		hint = entries;
+	}
+	void operator()( const directory_entry &entry )
+	{
+		if( hint )
+		{
+			// an empty directory is followed by an entry of another one
+			if( hinted.empty() || entry.path().parent_path() == hinted )
+				parser.reserveDirectoryOf( entry.path().string(), hint );
+			hint = 0;
+		}
+		parser.insert( entry.path().string() );
+		if( !subdirectories )
+			return;
+		// the entry type usually comes from readdir, only followed links cost a call
+		const file_status status = entry.symlink_status();
+		if( followSymlinks && is_symlink( status ) )
+		{
+			countSyscalls( statistics, 1 );
+			if( is_directory( entry.status() ) )
+				subdirectories->push_back( entry.path() );
+		}
+		else if( is_directory( status ) )
+			subdirectories->push_back( entry.path() );
 	}
 	Parser &parser;
+	vector<path> *subdirectories;
+	size_t hint;
+	path hinted;
+	bool followSymlinks;
+	Statistics *statistics;
 };
 
-std::vector<BrowseItem> browse( const char* directory, bool recursive )
+/**
+ * Inserts the content of 'folder' and of its sub directories, symbolic
+ * links followed, each physical directory being listed once.
+ * Returns the number of directories listed.
+ */
+static size_t insertFollowingLinks( const path &folder, Parser &parser, bool presize, Statistics *statistics )
+{
+	DirectoryIds visited;
+	firstVisit( visited, folder, statistics );
+	vector<path> pending( 1, folder );
+	size_t listed = 0;
+	while( !pending.empty() )
+	{
+		const path current = pending.back();
+		pending.pop_back();
+		vector<path> subdirectories;
+		for_each( directory_iterator( current ),
+				  directory_iterator(),
+				  Proxy( parser, &subdirectories, presizeHint( current, presize, statistics ), true, statistics ) );
+		++listed;
+		for( vector<path>::reverse_iterator itr = subdirectories.rbegin(); itr != subdirectories.rend(); ++itr )
+			if( firstVisit( visited, *itr, statistics ) )
+				pending.push_back( *itr );
+	}
+	return listed;
+}
+
+/**
+ * Browses 'folder', recursively if options.recursive is set.
+ * Sub directories are collected in 'subdirectories' if given, symbolic
+ * links excluded unless options.followSymlinks is set.
+ */
+static BrowseItems browseFolder( const path &folder, const BrowseOptions &options, vector<path> *subdirectories )
 {
-	const path folder = getDirectory( directory );
+	Statistics *statistics = options.statistics;
 	Parser parser;
-	if( recursive )
+	parser.setStatistics( statistics );
+	parser.setVersionPrefix( options.versionPrefix );
+	parser.setSplitStrategy( options.splitStrategy );
+	{
+		// the time spent inserting is accounted by the parser itself
+		const Statistics before = statistics ? *statistics : Statistics();
+		ScopedTimer timer( statistics, &Statistics::readdirTime );
+		size_t listed = 1;
+		if( options.recursive && options.followSymlinks )
+		{
+			listed = insertFollowingLinks( folder, parser, options.presize, statistics );
+		}
+		else if( options.recursive )
+		{
+			Proxy proxy( parser, NULL, presizeHint( folder, options.presize, statistics ) );
+			for( recursive_directory_iterator itr( folder ), end; itr != end; ++itr )
+			{
+				proxy( *itr );
+				// the iterator descends into directories, links excluded
+				if( is_directory( itr->symlink_status() ) )
+				{
+					++listed;
+					if( options.presize )
+						proxy.hintNext( itr->path(), presizeHint( itr->path(), true, statistics ) );
+				}
+			}
+		}
+		else
+		{
+			for_each( directory_iterator( folder ),
+					  directory_iterator(),
+					  Proxy( parser, subdirectories, presizeHint( folder, options.presize, statistics ), options.followSymlinks, statistics ) );
+		}
+		if( statistics )
+		{
+			statistics->readdirTime -= ( statistics->extractTime - before.extractTime ) + ( statistics->lookupTime - before.lookupTime );
+			statistics->syscalls += statistics->entries - before.entries + listed;
+			statistics->directories += listed;
+		}
+	}
+	vector<BrowseItem> items;
+	parser.releaseResults( items );
+	{
+		ScopedTimer timer( statistics, &Statistics::typeTime );
+		countSyscalls( statistics, changeTypesIfNeeded( items ) );
+	}
+	if( options.gatherMetadata )
+	{
+		ScopedTimer timer( statistics, &Statistics::metadataTime );
+		countSyscalls( statistics, gatherMetadata( items ) );
+	}
+	if( options.sorted )
+	{
+		ScopedTimer timer( statistics, &Statistics::sortTime );
+		sortItems( items );
+	}
+	return items;
+}
+
+std::vector<BrowseItem> browse( const char* directory, bool recursive )
+{
+	BrowseOptions options;
+	options.recursive = recursive;
+	return browse( directory, options );
+}
+
+std::vector<BrowseItem> browse( const char* directory, const BrowseOptions &options )
+{
+	return browseFolder( getDirectory( directory ), options, NULL );
+}
+
+BrowseItems browseDirectory( const char* directory, const BrowseOptions &options, vector<path> &subdirectories )
+{
+	BrowseOptions local( options );
+	local.recursive = false;
+	return browseFolder( getDirectory( directory ), local, &subdirectories );
+}
+
+/**
+ * Each thread browses the next directory not taken yet
+ */
+struct SEQUENCEPARSER_LOCAL ManyBrowser
+{
+	ManyBrowser( const vector<string> &directories, const BrowseOptions &options, vector<BrowseItems> &results ) :
+		directories( directories ),
+		options( options ),
+		results( results ),
+		nextDirectory( 0 )
+	{
+	}
+
+	void operator()()
 	{
-		for_each( recursive_directory_iterator( folder ),
-				  recursive_directory_iterator(),
-				  Proxy( parser ) );
+		Statistics statistics;
+		BrowseOptions local( options );
+		local.statistics = options.statistics ? &statistics : NULL;
+		size_t index;
+		while( acquire( index ) )
+		{
+			try
+			{
+				BrowseItems items = browse( directories[index].c_str(), local );
+				results[index].swap( items );
+			}
+			catch( std::exception &e )
+			{
+				boost::lock_guard<boost::mutex> lock( mutex );
+				if( error.empty() )
+					error = e.what();
+			}
+		}
+		if( options.statistics )
+		{
+			boost::lock_guard<boost::mutex> lock( mutex );
+			*options.statistics += statistics;
+		}
 	}
+
+	bool acquire( size_t &index )
+	{
+		boost::lock_guard<boost::mutex> lock( mutex );
+		if( nextDirectory == directories.size() || !error.empty() )
+			return false;
+		index = nextDirectory++;
+		return true;
+	}
+
+	const vector<string> &directories;
+	const BrowseOptions &options;
+	vector<BrowseItems> &results;
+	size_t nextDirectory;
+	string error;
+	boost::mutex mutex;
+};
+
+vector<BrowseItems> browseMany( const vector<string> &directories, const BrowseOptions &options, size_t threads )
+{
+	vector<BrowseItems> results( directories.size() );
+	if( threads == 0 )
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+	threads = min( threads, directories.size() );
+	ManyBrowser browser( directories, options, results );
+	if( threads <= 1 )
+		browser();
 	else
 	{
-		for_each( directory_iterator( folder ),
-				  directory_iterator(),
-				  Proxy( parser ) );
+		boost::thread_group group;
+		for( size_t i = 0; i < threads; ++i )
+			group.create_thread( boost::ref( browser ) );
+		group.join_all();
 	}
-	vector<BrowseItem> items = parser.getResults();
-	for_each( items.begin(), items.end(), &changeTypeIfNeeded );
+	if( !browser.error.empty() )
+		throw std::ios_base::failure( browser.error );
+	return results;
+}
 
-	return items;
+Walker::Walker( const char* directory, const BrowseOptions &options ) :
+	options( options ),
+	recursive( options.recursive )
+{
+	this->options.recursive = false;
+	pending.push_back( getDirectory( directory ) );
+	if( options.followSymlinks )
+		firstVisit( visited, pending.back(), options.statistics );
+}
+
+bool Walker::next( BrowseItems &items )
+{
+	if( pending.empty() )
+	{
+		items.clear();
+		return false;
+	}
+	current = pending.back();
+	pending.pop_back();
+	vector<path> subdirectories;
+	BrowseItems browsed = browseFolder( current, options, recursive ? &subdirectories : NULL );
+	items.swap( browsed );
+	// pushed backward so directories are visited in listing order
+	for( vector<path>::reverse_iterator itr = subdirectories.rbegin(); itr != subdirectories.rend(); ++itr )
+		if( !options.followSymlinks || firstVisit( visited, *itr, options.statistics ) )
+			pending.push_back( *itr );
+	return true;
 }
 
 }
@@ -10,6 +10,10 @@
 
 #include <sequence/Config.h>
 #include <sequence/BrowseItem.h>
+#include <boost/cstdint.hpp>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace sequence
@@ -20,8 +24,66 @@ typedef std::vector<sequence::BrowseItem> BrowseItems;
 namespace parser
 {
 
+struct Statistics;
+
+/**
+ * Identifies directories whatever the path they are reached by, as
+ * (device, inode) pairs, or hashes of their canonical path on Windows
+ */
+typedef std::set<std::pair<boost::uint64_t, boost::uint64_t> > DirectoryIds;
+
+/**
+ * How patterns having several varying numbers are split into sequences
+ */
+enum SplitStrategy
+{
+	SPLIT_FRAME_LAST,   ///< the rightmost number is the frame number, split on the others first
+	SPLIT_FEWEST_VALUES ///< always split on the number having the fewest distinct values
+};
+
+/**
+ * Fine tuning of the browse operation
+ */
+struct SEQUENCEPARSER_API BrowseOptions
+{
+	bool recursive;      ///< also browse sub directories
+	bool gatherMetadata; ///< fill Sequence::metadata with files size and modification time
+	bool sorted;         ///< return the items in natural order, see sortItems()
+	Statistics *statistics; ///< if not NULL, counters and timings are added to it
+	std::string versionPrefix; ///< if not empty, only the latest version of each sequence is kept, see Parser::setVersionPrefix
+	SplitStrategy splitStrategy;
+	bool presize;        ///< size the parser tables of each directory from its size, for huge directories of unrelated files, see Parser::reserveDirectoryOf
+	bool followSymlinks; ///< browse the directories symbolic links point to, each directory being listed once
+
+	BrowseOptions() :
+		recursive( false ),
+		gatherMetadata( false ),
+		sorted( false ),
+		statistics( NULL ),
+		splitStrategy( SPLIT_FRAME_LAST ),
+		presize( false ),
+		followSymlinks( false )
+	{}
+};
+
 BrowseItems SEQUENCEPARSER_API browse( const char* directory, bool recursive = false );
 
+BrowseItems SEQUENCEPARSER_API browse( const char* directory, const BrowseOptions &options );
+
+/**
+ * Browses a single directory, options.recursive is ignored.
+ * Its sub directories, symbolic links excluded unless options.followSymlinks
+ * is set, are appended to 'subdirectories'.
+ */
+BrowseItems SEQUENCEPARSER_API browseDirectory( const char* directory, const BrowseOptions &options, std::vector<boost::filesystem::path> &subdirectories );
+
+/**
+ * Browses several directories concurrently, results are in the same order
+ * as the directories. Uses as many threads as cores when 'threads' is 0.
+ * Statistics of all the directories are summed in options.statistics.
+ */
+std::vector<BrowseItems> SEQUENCEPARSER_API browseMany( const std::vector<std::string> &directories, const BrowseOptions &options, size_t threads = 0 );
+
 }
 
 /**
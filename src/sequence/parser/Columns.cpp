@@ -0,0 +1,84 @@
+#include "Columns.h"
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+BrowseItem Columns::item( size_t index ) const
+{
+	const BrowseItemType type = static_cast<BrowseItemType>( types[index] );
+	const boost::filesystem::path directory( strings[directories[index]] );
+	if( type != SEQUENCE )
+		return BrowseItem( type, directory / strings[prefixes[index]] );
+	const SequencePattern pattern( strings[prefixes[index]], strings[suffixes[index]], paddings[index] );
+	return BrowseItem( type, directory, Sequence( pattern, Range( firsts[index], lasts[index] ), steps[index] ) );
+}
+
+ColumnsBuilder::ColumnsBuilder( Columns &columns ) :
+	columns( columns )
+{
+	empty = intern( string() );
+}
+
+boost::uint32_t ColumnsBuilder::intern( const string &value )
+{
+	const pair<Indices::iterator, bool> inserted = indices.insert( make_pair( value, static_cast<boost::uint32_t>( columns.strings.size() ) ) );
+	if( inserted.second )
+		columns.strings.push_back( value );
+	return inserted.first->second;
+}
+
+void ColumnsBuilder::addFile( BrowseItemType type, boost::uint32_t directory, boost::uint32_t filename )
+{
+	columns.types.push_back( static_cast<boost::uint8_t>( type ) );
+	columns.directories.push_back( directory );
+	columns.prefixes.push_back( filename );
+	columns.suffixes.push_back( empty );
+	columns.firsts.push_back( 0 );
+	columns.lasts.push_back( 0 );
+	columns.steps.push_back( 0 );
+	columns.paddings.push_back( 0 );
+}
+
+void ColumnsBuilder::addSequence( boost::uint32_t directory, const SequencePattern &pattern, const Range &range, unsigned short step )
+{
+	columns.types.push_back( static_cast<boost::uint8_t>( SEQUENCE ) );
+	columns.directories.push_back( directory );
+	columns.prefixes.push_back( intern( pattern.prefix ) );
+	columns.suffixes.push_back( intern( pattern.suffix ) );
+	columns.firsts.push_back( range.first );
+	columns.lasts.push_back( range.last );
+	columns.steps.push_back( step );
+	columns.paddings.push_back( pattern.padding );
+}
+
+void ColumnsBuilder::add( const BrowseItem &item )
+{
+	if( item.type == SEQUENCE )
+		addSequence( intern( item.path.string() ), item.sequence.pattern, item.sequence.range, item.sequence.step );
+	else
+		addFile( item.type, intern( item.path.parent_path().string() ), intern( item.path.filename().string() ) );
+}
+
+Columns toColumns( const BrowseItems &items )
+{
+	Columns columns;
+	const size_t size = items.size();
+	columns.types.reserve( size );
+	columns.directories.reserve( size );
+	columns.prefixes.reserve( size );
+	columns.suffixes.reserve( size );
+	columns.firsts.reserve( size );
+	columns.lasts.reserve( size );
+	columns.steps.reserve( size );
+	columns.paddings.reserve( size );
+
+	ColumnsBuilder builder( columns );
+	for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+		builder.add( *itr );
+	return columns;
+}
+
+}
+}
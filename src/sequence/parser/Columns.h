@@ -0,0 +1,90 @@
+/*
+ * Columns.h
+ *
+ * Columnar form of the browse results.
+ */
+
+#ifndef COLUMNS_H_
+#define COLUMNS_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <string>
+#include <vector>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * Browse results stored as one contiguous array per field, item i being
+ * made of the i-th element of each array.
+ * Strings are interned : 'directories', 'prefixes' and 'suffixes' are
+ * indices in 'strings'. A FOLDER or UNITFILE item stores its filename in
+ * 'prefixes' and an empty suffix, its range, step and padding are 0.
+ */
+struct SEQUENCEPARSER_API Columns
+{
+	std::vector<boost::uint8_t> types;        ///< BrowseItemType
+	std::vector<boost::uint32_t> directories;
+	std::vector<boost::uint32_t> prefixes;
+	std::vector<boost::uint32_t> suffixes;
+	std::vector<boost::uint32_t> firsts;
+	std::vector<boost::uint32_t> lasts;
+	std::vector<boost::uint16_t> steps;
+	std::vector<boost::uint8_t> paddings;
+	std::vector<std::string> strings;
+
+	size_t size() const
+	{
+		return types.size();
+	}
+
+	/**
+	 * Rebuilds the index-th item, metadata is not kept in columns
+	 */
+	BrowseItem item( size_t index ) const;
+};
+
+/**
+ * Appends items to Columns, interning their strings.
+ * The strings already in the Columns are not reused.
+ */
+class SEQUENCEPARSER_API ColumnsBuilder : boost::noncopyable
+{
+public:
+	explicit ColumnsBuilder( Columns &columns );
+
+	boost::uint32_t intern( const std::string &value );
+
+	/**
+	 * Appends a FOLDER or UNITFILE, 'directory' and 'filename' being interned strings
+	 */
+	void addFile( BrowseItemType type, boost::uint32_t directory, boost::uint32_t filename );
+
+	/**
+	 * Appends a SEQUENCE, 'directory' being an interned string
+	 */
+	void addSequence( boost::uint32_t directory, const SequencePattern &pattern, const Range &range, unsigned short step );
+
+	void add( const BrowseItem &item );
+
+private:
+	typedef boost::unordered_map<std::string, boost::uint32_t> Indices;
+	Columns &columns;
+	Indices indices;
+	boost::uint32_t empty;
+};
+
+SEQUENCEPARSER_API Columns toColumns( const BrowseItems &items );
+
+}
+}
+
+#endif
@@ -0,0 +1,519 @@
+#include "Daemon.h"
+
+#ifdef SEQUENCEPARSER_HAS_DAEMON
+
+#include "BrowseCache.h"
+#include "Metadata.h"
+#include "NaturalSort.h"
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+using namespace std;
+using namespace boost::filesystem;
+using boost::asio::local::stream_protocol;
+
+namespace sequence {
+namespace parser {
+
+/*
+ * Messages are a native endian uint32 size followed by the body, client and
+ * server running on the same host.
+ *
+ * Request  : uint8 version, uint8 flags, string absolute directory
+ * Response : uint8 status, then uint32 count and the items if status is
+ *            STATUS_OK, a string error message otherwise
+ * Item     : uint8 type, string path relative to the requested directory,
+ *            for sequences string prefix, string suffix, uint8 padding,
+ *            uint32 first, uint32 last, uint16 step,
+ *            when metadata is requested uint64 size, int64 minTime,
+ *            int64 maxTime, uint32 count
+ *
+ * Strings are a uint32 size followed by the characters.
+ */
+static const boost::uint8_t gProtocolVersion = 2;
+static const boost::uint32_t gMaxMessageSize = 1u << 30;
+
+enum RequestFlags
+{
+	FLAG_RECURSIVE = 1,
+	FLAG_METADATA = 2,
+	FLAG_SPLIT_FEWEST_VALUES = 4,
+	FLAG_FOLLOW_SYMLINKS = 8
+};
+
+/**
+ * Each combination of the flags changing the listings has its own cache
+ */
+static const size_t gCacheCount = 4;
+
+static size_t cacheIndex( boost::uint8_t flags )
+{
+	return ( flags & FLAG_SPLIT_FEWEST_VALUES ? 1 : 0 ) | ( flags & FLAG_FOLLOW_SYMLINKS ? 2 : 0 );
+}
+
+enum ResponseStatus
+{
+	STATUS_OK,
+	STATUS_ERROR
+};
+
+string defaultSocketPath()
+{
+	const char* socketPath = getenv( "LSSD_SOCKET" );
+	if( socketPath && *socketPath )
+		return socketPath;
+	return "/tmp/lssd-" + boost::lexical_cast<string>( getuid() ) + ".sock";
+}
+
+/**
+ * Appends values to a message, its size is filled by finish()
+ */
+struct SEQUENCEPARSER_LOCAL MessageWriter
+{
+	MessageWriter() :
+		buffer( sizeof( boost::uint32_t ), '\0' )
+	{
+	}
+
+	template<typename T>
+	void write( const T value )
+	{
+		buffer.append( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+	}
+
+	void writeString( const char* data, size_t size )
+	{
+		write( boost::uint32_t( size ) );
+		buffer.append( data, size );
+	}
+
+	void writeString( const string &value )
+	{
+		writeString( value.data(), value.size() );
+	}
+
+	const string& finish()
+	{
+		const boost::uint32_t size = buffer.size() - sizeof( boost::uint32_t );
+		memcpy( &buffer[0], &size, sizeof( size ) );
+		return buffer;
+	}
+
+	string buffer;
+};
+
+/**
+ * Reads values from a message body, throws if it is too short
+ */
+struct SEQUENCEPARSER_LOCAL MessageReader
+{
+	MessageReader( const string &body ) :
+		current( body.data() ),
+		end( body.data() + body.size() )
+	{
+	}
+
+	template<typename T>
+	T read()
+	{
+		T value;
+		check( sizeof( T ) );
+		memcpy( &value, current, sizeof( T ) );
+		current += sizeof( T );
+		return value;
+	}
+
+	string readString()
+	{
+		const boost::uint32_t size = read<boost::uint32_t>();
+		check( size );
+		const string value( current, size );
+		current += size;
+		return value;
+	}
+
+	void check( size_t size ) const
+	{
+		if( size_t( end - current ) < size )
+			throw ios_base::failure( "Malformed lssd message" );
+	}
+
+	const char* current;
+	const char* end;
+};
+
+static void writeItem( MessageWriter &writer, const BrowseItem &item, size_t rootSize, bool metadata )
+{
+	writer.write( boost::uint8_t( item.type ) );
+	const string &itemPath = item.path.string();
+	if( itemPath.size() > rootSize )
+		writer.writeString( itemPath.data() + rootSize, itemPath.size() - rootSize );
+	else
+		writer.writeString( NULL, 0 );
+	const Sequence &sequence = item.sequence;
+	if( item.type == SEQUENCE )
+	{
+		writer.writeString( sequence.pattern.prefix );
+		writer.writeString( sequence.pattern.suffix );
+		writer.write( boost::uint8_t( sequence.pattern.padding ) );
+		writer.write( boost::uint32_t( sequence.range.first ) );
+		writer.write( boost::uint32_t( sequence.range.last ) );
+		writer.write( boost::uint16_t( sequence.step ) );
+	}
+	if( metadata )
+	{
+		writer.write( boost::uint64_t( sequence.metadata.size ) );
+		writer.write( boost::int64_t( sequence.metadata.minTime ) );
+		writer.write( boost::int64_t( sequence.metadata.maxTime ) );
+		writer.write( boost::uint32_t( sequence.metadata.count ) );
+	}
+}
+
+static BrowseItem readItem( MessageReader &reader, const path &directory, bool metadata )
+{
+	BrowseItem item;
+	item.type = BrowseItemType( reader.read<boost::uint8_t>() );
+	item.path = directory / reader.readString();
+	Sequence &sequence = item.sequence;
+	if( item.type == SEQUENCE )
+	{
+		sequence.pattern.prefix = reader.readString();
+		sequence.pattern.suffix = reader.readString();
+		sequence.pattern.padding = reader.read<boost::uint8_t>();
+		sequence.range.first = reader.read<boost::uint32_t>();
+		sequence.range.last = reader.read<boost::uint32_t>();
+		sequence.step = reader.read<boost::uint16_t>();
+	}
+	if( metadata )
+	{
+		sequence.metadata.size = reader.read<boost::uint64_t>();
+		sequence.metadata.minTime = reader.read<boost::int64_t>();
+		sequence.metadata.maxTime = reader.read<boost::int64_t>();
+		sequence.metadata.count = reader.read<boost::uint32_t>();
+	}
+	return item;
+}
+
+/**
+ * The caches shared by all the sessions and the requests decoding
+ */
+class SEQUENCEPARSER_LOCAL ListingService
+{
+public:
+	ListingService() :
+		requests( 0 )
+	{
+		for( size_t i = 0; i < gCacheCount; ++i )
+		{
+			BrowseOptions options;
+			options.splitStrategy = i & 1 ? SPLIT_FEWEST_VALUES : SPLIT_FRAME_LAST;
+			options.followSymlinks = ( i & 2 ) != 0;
+			caches[i].reset( new BrowseCache( options ) );
+		}
+	}
+
+	/**
+	 * Decodes a request and returns the encoded response, errors included
+	 */
+	string serve( const string &request )
+	{
+		{
+			boost::lock_guard<boost::mutex> lock( mutex );
+			++requests;
+		}
+		MessageWriter writer;
+		try
+		{
+			MessageReader reader( request );
+			if( reader.read<boost::uint8_t>() != gProtocolVersion )
+				throw ios_base::failure( "Unsupported lssd protocol version" );
+			const boost::uint8_t flags = reader.read<boost::uint8_t>();
+			string root = reader.readString();
+			while( root.size() > 1 && root[root.size() - 1] == '/' )
+				root.erase( root.size() - 1 );
+			const size_t rootSize = root.size() + ( root == "/" ? 0 : 1 );
+
+			// the tree is walked as Walker does
+			const vector<CachedListingPtr> visited = caches[cacheIndex( flags )]->listings( path( root ), ( flags & FLAG_RECURSIVE ) != 0 );
+			size_t count = 0;
+			for( vector<CachedListingPtr>::const_iterator itr = visited.begin(); itr != visited.end(); ++itr )
+				count += ( *itr )->items.size();
+
+			writer.write( boost::uint8_t( STATUS_OK ) );
+			writer.write( boost::uint32_t( count ) );
+			if( flags & FLAG_METADATA )
+			{
+				BrowseItems items;
+				items.reserve( count );
+				for( vector<CachedListingPtr>::const_iterator itr = visited.begin(); itr != visited.end(); ++itr )
+					items.insert( items.end(), ( *itr )->items.begin(), ( *itr )->items.end() );
+				gatherMetadata( items );
+				for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+					writeItem( writer, *itr, rootSize, true );
+			}
+			else
+			{
+				for( vector<CachedListingPtr>::const_iterator listing = visited.begin(); listing != visited.end(); ++listing )
+					for( BrowseItems::const_iterator itr = ( *listing )->items.begin(); itr != ( *listing )->items.end(); ++itr )
+						writeItem( writer, *itr, rootSize, false );
+			}
+			if( writer.buffer.size() > gMaxMessageSize )
+				throw ios_base::failure( "Too many items for a lssd response" );
+		}
+		catch( std::exception &e )
+		{
+			writer = MessageWriter();
+			writer.write( boost::uint8_t( STATUS_ERROR ) );
+			writer.writeString( e.what() );
+		}
+		return writer.finish();
+	}
+
+	DaemonCounters counters() const
+	{
+		DaemonCounters result;
+		for( size_t i = 0; i < gCacheCount; ++i )
+		{
+			const BrowseCacheCounters cached = caches[i]->counters();
+			result.hits += cached.hits;
+			result.misses += cached.misses;
+			result.directories += cached.directories;
+		}
+		boost::lock_guard<boost::mutex> lock( mutex );
+		result.requests = requests;
+		return result;
+	}
+
+private:
+	boost::scoped_ptr<BrowseCache> caches[gCacheCount];
+	boost::uint64_t requests;
+	mutable boost::mutex mutex;
+};
+
+/**
+ * A client connection, serving its requests one after the other
+ */
+class SEQUENCEPARSER_LOCAL Session : public boost::enable_shared_from_this<Session>
+{
+public:
+	Session( boost::asio::io_service &ioService, ListingService &service ) :
+		socket( ioService ),
+		service( service )
+	{
+	}
+
+	void start()
+	{
+		boost::asio::async_read( socket, boost::asio::buffer( &size, sizeof( size ) ),
+								 boost::bind( &Session::onSize, shared_from_this(), boost::asio::placeholders::error ) );
+	}
+
+	stream_protocol::socket socket;
+
+private:
+	void onSize( const boost::system::error_code &error )
+	{
+		if( error || size == 0 || size > gMaxMessageSize )
+			return;
+		request.resize( size );
+		boost::asio::async_read( socket, boost::asio::buffer( &request[0], size ),
+								 boost::bind( &Session::onRequest, shared_from_this(), boost::asio::placeholders::error ) );
+	}
+
+	void onRequest( const boost::system::error_code &error )
+	{
+		if( error )
+			return;
+		// listing is blocking, other sessions are served by the other threads
+		response = service.serve( request );
+		boost::asio::async_write( socket, boost::asio::buffer( response ),
+								  boost::bind( &Session::onResponse, shared_from_this(), boost::asio::placeholders::error ) );
+	}
+
+	void onResponse( const boost::system::error_code &error )
+	{
+		if( !error )
+			start();
+	}
+
+	ListingService &service;
+	boost::uint32_t size;
+	string request;
+	string response;
+};
+
+struct DaemonServer::Implementation
+{
+	Implementation( const string &socketPath ) :
+		socketPath( socketPath ),
+		acceptor( ioService )
+	{
+		const stream_protocol::endpoint endpoint( socketPath );
+		boost::system::error_code error;
+		{
+			stream_protocol::socket probe( ioService );
+			probe.connect( endpoint, error );
+			if( !error )
+				throw ios_base::failure( "A daemon is already listening on " + socketPath );
+		}
+		// stale socket left by a daemon which was killed
+		remove( socketPath, error );
+		acceptor.open( endpoint.protocol(), error );
+		if( !error )
+			acceptor.bind( endpoint, error );
+		if( !error )
+			acceptor.listen( boost::asio::socket_base::max_connections, error );
+		if( error )
+			throw ios_base::failure( "Unable to listen on " + socketPath + ": " + error.message() );
+	}
+
+	void accept()
+	{
+		const boost::shared_ptr<Session> session = boost::make_shared<Session>( boost::ref( ioService ), boost::ref( service ) );
+		acceptor.async_accept( session->socket,
+							   boost::bind( &Implementation::onAccept, this, session, boost::asio::placeholders::error ) );
+	}
+
+	void onAccept( const boost::shared_ptr<Session> &session, const boost::system::error_code &error )
+	{
+		if( error == boost::asio::error::operation_aborted )
+			return;
+		if( !error )
+			session->start();
+		accept();
+	}
+
+	const string socketPath;
+	boost::asio::io_service ioService;
+	stream_protocol::acceptor acceptor;
+	ListingService service;
+};
+
+DaemonServer::DaemonServer( const string &socketPath ) :
+	implementation( new Implementation( socketPath ) )
+{
+}
+
+DaemonServer::~DaemonServer()
+{
+}
+
+void DaemonServer::run( size_t threads )
+{
+	if( threads == 0 )
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+	implementation->accept();
+	boost::thread_group group;
+	for( size_t i = 1; i < threads; ++i )
+		group.create_thread( boost::bind( &boost::asio::io_service::run, &implementation->ioService ) );
+	implementation->ioService.run();
+	group.join_all();
+	boost::system::error_code ignored;
+	implementation->acceptor.close( ignored );
+	remove( implementation->socketPath, ignored );
+}
+
+void DaemonServer::stop()
+{
+	implementation->ioService.stop();
+}
+
+DaemonCounters DaemonServer::counters() const
+{
+	return implementation->service.counters();
+}
+
+struct DaemonClient::Implementation
+{
+	Implementation() :
+		socket( ioService )
+	{
+	}
+
+	/**
+	 * Sends the request and returns the response body
+	 */
+	string exchange( const string &request )
+	{
+		try
+		{
+			boost::asio::write( socket, boost::asio::buffer( request ) );
+			boost::uint32_t size;
+			boost::asio::read( socket, boost::asio::buffer( &size, sizeof( size ) ) );
+			if( size == 0 || size > gMaxMessageSize )
+				throw ios_base::failure( "Malformed lssd message" );
+			string response( size, '\0' );
+			boost::asio::read( socket, boost::asio::buffer( &response[0], size ) );
+			return response;
+		}
+		catch( boost::system::system_error &e )
+		{
+			throw ios_base::failure( string( "Lost connection to lssd: " ) + e.what() );
+		}
+	}
+
+	boost::asio::io_service ioService;
+	stream_protocol::socket socket;
+};
+
+DaemonClient::DaemonClient( const string &socketPath ) :
+	implementation( new Implementation() )
+{
+	boost::system::error_code error;
+	implementation->socket.connect( stream_protocol::endpoint( socketPath ), error );
+	if( error )
+		throw ios_base::failure( "Unable to connect to lssd on " + socketPath + ": " + error.message() );
+}
+
+DaemonClient::~DaemonClient()
+{
+}
+
+BrowseItems DaemonClient::browse( const char* directory, const BrowseOptions &options )
+{
+	if( !options.versionPrefix.empty() )
+		throw ios_base::failure( "lssd does not keep the latest versions only" );
+	// items are rebuilt relative to the directory as given so paths match the ones of parser::browse
+	const path folder( directory == NULL ? "." : directory );
+	MessageWriter writer;
+	writer.write( gProtocolVersion );
+	writer.write( boost::uint8_t( ( options.recursive ? FLAG_RECURSIVE : 0 ) |
+								  ( options.gatherMetadata ? FLAG_METADATA : 0 ) |
+								  ( options.followSymlinks ? FLAG_FOLLOW_SYMLINKS : 0 ) |
+								  ( options.splitStrategy == SPLIT_FEWEST_VALUES ? FLAG_SPLIT_FEWEST_VALUES : 0 ) ) );
+	writer.writeString( absolute( folder ).string() );
+
+	const string response = implementation->exchange( writer.finish() );
+	MessageReader reader( response );
+	if( reader.read<boost::uint8_t>() != STATUS_OK )
+		throw ios_base::failure( reader.readString() );
+	const boost::uint32_t count = reader.read<boost::uint32_t>();
+	// every item takes at least five bytes
+	reader.check( count * size_t( 5 ) );
+	BrowseItems items;
+	items.reserve( count );
+	for( boost::uint32_t i = 0; i < count; ++i )
+		items.push_back( readItem( reader, folder, options.gatherMetadata ) );
+	if( options.sorted )
+		sortItems( items );
+	return items;
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * Daemon.h
+ *
+ * Browsing through a local daemon sharing its cached listings, see app/lssd.cpp.
+ * Only available on POSIX systems with Unix domain sockets, where
+ * SEQUENCEPARSER_HAS_DAEMON is defined.
+ */
+
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/asio/detail/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <string>
+
+#if defined( BOOST_ASIO_HAS_LOCAL_SOCKETS ) && !defined( _WIN32 )
+#define SEQUENCEPARSER_HAS_DAEMON
+#endif
+
+#ifdef SEQUENCEPARSER_HAS_DAEMON
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * $LSSD_SOCKET if set, /tmp/lssd-<uid>.sock otherwise
+ */
+SEQUENCEPARSER_API std::string defaultSocketPath();
+
+/**
+ * Counters of a DaemonServer
+ */
+struct SEQUENCEPARSER_API DaemonCounters
+{
+	boost::uint64_t requests;    ///< browse requests served, failed ones included
+	boost::uint64_t hits;        ///< directories served from the cache
+	boost::uint64_t misses;      ///< directories listed on disk
+	boost::uint64_t directories; ///< directories currently cached
+
+	DaemonCounters() :
+		requests( 0 ),
+		hits( 0 ),
+		misses( 0 ),
+		directories( 0 )
+	{}
+};
+
+/**
+ * Serves browse requests on a Unix domain socket.
+ *
+ * Listings are cached per directory by a BrowseCache without ttl, one per
+ * combination of split strategy and symbolic links following : they
+ * are listed again when the directory modification time changes, which
+ * happens whenever an entry is added, removed or renamed. Metadata is
+ * gathered again for every request as modifying a file does not touch its
+ * directory.
+ */
+class SEQUENCEPARSER_API DaemonServer : boost::noncopyable
+{
+public:
+	/**
+	 * Binds the socket, replacing any stale socket file
+	 */
+	explicit DaemonServer( const std::string &socketPath = defaultSocketPath() );
+	~DaemonServer();
+
+	/**
+	 * Serves the clients until stop() is called, using as many threads as
+	 * cores when 'threads' is 0. Removes the socket file before returning.
+	 */
+	void run( size_t threads = 0 );
+
+	/**
+	 * Makes run() return, can be called from any thread
+	 */
+	void stop();
+
+	DaemonCounters counters() const;
+
+private:
+	struct Implementation;
+	boost::scoped_ptr<Implementation> implementation;
+};
+
+/**
+ * Connection to a DaemonServer.
+ * browse() returns the same items as sequence::parser::browse, paths
+ * included, honoring the recursive, gatherMetadata, sorted, splitStrategy
+ * and followSymlinks options. options.statistics is not filled and
+ * options.presize is ignored. A non empty options.versionPrefix is not
+ * supported and throws.
+ * Failures, including a lost connection, throw std::ios_base::failure.
+ */
+class SEQUENCEPARSER_API DaemonClient : boost::noncopyable
+{
+public:
+	explicit DaemonClient( const std::string &socketPath = defaultSocketPath() );
+	~DaemonClient();
+
+	BrowseItems browse( const char* directory, const BrowseOptions &options = BrowseOptions() );
+
+private:
+	struct Implementation;
+	boost::scoped_ptr<Implementation> implementation;
+};
+
+}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,189 @@
+#include "FlatItems.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+namespace {
+
+/**
+ * Interns strings directly in the offsets and chars sections
+ */
+class SEQUENCEPARSER_LOCAL FlatStrings
+{
+public:
+	FlatStrings() :
+		offsets( 1, 0 )
+	{
+	}
+
+	boost::uint32_t intern( const string &value )
+	{
+		const pair<Indices::iterator, bool> inserted = indices.insert( make_pair( value, static_cast<boost::uint32_t>( offsets.size() - 1 ) ) );
+		if( inserted.second )
+		{
+			chars.append( value );
+			if( chars.size() > numeric_limits<boost::uint32_t>::max() )
+				throw ios_base::failure( "Too many characters for a flat file" );
+			offsets.push_back( static_cast<boost::uint32_t>( chars.size() ) );
+		}
+		return inserted.first->second;
+	}
+
+	vector<boost::uint32_t> offsets;
+	string chars;
+
+private:
+	typedef boost::unordered_map<string, boost::uint32_t> Indices;
+	Indices indices;
+};
+
+}
+
+void writeFlat( ostream &stream, const BrowseItems &items )
+{
+	vector<FlatRecord> records;
+	records.reserve( items.size() );
+	FlatStrings strings;
+	const boost::uint32_t empty = strings.intern( string() );
+	for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+	{
+		FlatRecord record;
+		record.type = static_cast<boost::uint8_t>( itr->type );
+		if( itr->type == SEQUENCE )
+		{
+			const Sequence &sequence = itr->sequence;
+			record.directory = strings.intern( itr->path.string() );
+			record.prefix = strings.intern( sequence.pattern.prefix );
+			record.suffix = strings.intern( sequence.pattern.suffix );
+			record.first = sequence.range.first;
+			record.last = sequence.range.last;
+			record.step = sequence.step;
+			record.padding = sequence.pattern.padding;
+		}
+		else
+		{
+			record.directory = strings.intern( itr->path.parent_path().string() );
+			record.prefix = strings.intern( itr->path.filename().string() );
+			record.suffix = empty;
+			record.first = record.last = 0;
+			record.step = 0;
+			record.padding = 0;
+		}
+		records.push_back( record );
+	}
+
+	FlatHeader header;
+	memcpy( header.magic, gFlatMagic, sizeof( gFlatMagic ) );
+	header.version = gFlatVersion;
+	header.byteOrder = gFlatByteOrder;
+	header.recordSize = sizeof( FlatRecord );
+	header.reserved = 0;
+	header.recordCount = records.size();
+	header.stringCount = strings.offsets.size() - 1;
+	header.charCount = strings.chars.size();
+	stream.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+	if( !records.empty() )
+		stream.write( reinterpret_cast<const char*>( &records[0] ), records.size() * sizeof( FlatRecord ) );
+	stream.write( reinterpret_cast<const char*>( &strings.offsets[0] ), strings.offsets.size() * sizeof( boost::uint32_t ) );
+	stream.write( strings.chars.data(), strings.chars.size() );
+	if( !stream )
+		throw ios_base::failure( "Unable to write flat items" );
+}
+
+void writeFlat( const char* filename, const BrowseItems &items )
+{
+	boost::filesystem::ofstream stream( filename, ios::binary );
+	if( !stream )
+		throw ios_base::failure( string( "Unable to open " ) + filename );
+	writeFlat( stream, items );
+}
+
+struct FlatItems::Mapping
+{
+	Mapping( const char* filename ) :
+		file( filename, boost::interprocess::read_only ),
+		region( file, boost::interprocess::read_only )
+	{
+	}
+
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+};
+
+FlatItems::FlatItems( const char* filename )
+{
+	if( boost::filesystem::file_size( filename ) < sizeof( FlatHeader ) )
+		throw ios_base::failure( std::string( "Not a flat file " ) + filename );
+	mapping.reset( new Mapping( filename ) );
+	open( static_cast<const char*>( mapping->region.get_address() ), mapping->region.get_size() );
+}
+
+FlatItems::FlatItems( const void* data, size_t size )
+{
+	open( static_cast<const char*>( data ), size );
+}
+
+FlatItems::~FlatItems()
+{
+}
+
+void FlatItems::open( const char* data, size_t size )
+{
+	if( size < sizeof( FlatHeader ) )
+		throw ios_base::failure( "Truncated flat items" );
+	const FlatHeader &header = *reinterpret_cast<const FlatHeader*>( data );
+	if( memcmp( header.magic, gFlatMagic, sizeof( gFlatMagic ) ) != 0 )
+		throw ios_base::failure( "Not flat items" );
+	if( header.byteOrder != gFlatByteOrder )
+		throw ios_base::failure( "Flat items written with another byte order" );
+	if( header.version != gFlatVersion || header.recordSize < sizeof( FlatRecord ) || header.recordSize % sizeof( boost::uint32_t ) )
+		throw ios_base::failure( "Unsupported flat items version" );
+	// computed in 64 bits so huge counts in a corrupted header can't wrap
+	const boost::uint64_t expected = sizeof( FlatHeader ) + header.recordCount * header.recordSize +
+									 ( header.stringCount + 1 ) * sizeof( boost::uint32_t ) + header.charCount;
+	if( header.recordCount > size || header.recordSize > size || header.stringCount > size || header.charCount > size || expected != size )
+		throw ios_base::failure( "Truncated flat items" );
+	recordCount = header.recordCount;
+	recordSize = header.recordSize;
+	strings = header.stringCount;
+	records = data + sizeof( FlatHeader );
+	offsets = reinterpret_cast<const boost::uint32_t*>( records + recordCount * recordSize );
+	chars = reinterpret_cast<const char*>( offsets + strings + 1 );
+	if( offsets[strings] != header.charCount )
+		throw ios_base::failure( "Truncated flat items" );
+	for( size_t i = 0; i < strings; ++i )
+		if( offsets[i] > offsets[i + 1] )
+			throw ios_base::failure( "Corrupted flat items" );
+	for( size_t i = 0; i < recordCount; ++i )
+	{
+		const FlatRecord &flat = record( i );
+		if( flat.directory >= strings || flat.prefix >= strings || flat.suffix >= strings )
+			throw ios_base::failure( "Corrupted flat items" );
+	}
+}
+
+BrowseItem FlatItems::item( size_t index ) const
+{
+	const FlatRecord &flat = record( index );
+	const BrowseItemType type = static_cast<BrowseItemType>( flat.type );
+	const boost::filesystem::path directory( string( flat.directory ).to_string() );
+	if( type != SEQUENCE )
+		return BrowseItem( type, directory / string( flat.prefix ).to_string() );
+	const SequencePattern pattern( string( flat.prefix ).to_string(), string( flat.suffix ).to_string(), flat.padding );
+	return BrowseItem( type, directory, Sequence( pattern, Range( flat.first, flat.last ), flat.step ) );
+}
+
+}
+}
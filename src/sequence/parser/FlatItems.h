@@ -0,0 +1,136 @@
+/*
+ * FlatItems.h
+ *
+ * Flat binary form of the browse results, read in place.
+ */
+
+#ifndef FLATITEMS_H_
+#define FLATITEMS_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <ostream>
+
+namespace sequence
+{
+namespace parser
+{
+
+/*
+ * A flat file is, in the byte order of the host which wrote it :
+ *
+ *   FlatHeader
+ *   FlatRecord records[recordCount], each recordSize bytes long
+ *   uint32 offsets[stringCount + 1]
+ *   char chars[charCount], string i being chars[offsets[i], offsets[i + 1])
+ *
+ * Strings are interned as in Columns : a FOLDER or UNITFILE item stores its
+ * filename as prefix and an empty suffix, its range, step and padding are 0.
+ * Later versions may only append fields to FlatRecord.
+ */
+const char gFlatMagic[8] = { 'S', 'E', 'Q', 'I', 'T', 'E', 'M', 'S' };
+const boost::uint32_t gFlatVersion = 1;
+const boost::uint32_t gFlatByteOrder = 0x01020304;
+
+struct FlatHeader
+{
+	char magic[8];
+	boost::uint32_t version;
+	boost::uint32_t byteOrder;  ///< gFlatByteOrder as written by the host
+	boost::uint32_t recordSize;
+	boost::uint32_t reserved;
+	boost::uint64_t recordCount;
+	boost::uint64_t stringCount;
+	boost::uint64_t charCount;
+};
+
+struct FlatRecord
+{
+	boost::uint32_t directory; ///< string index
+	boost::uint32_t prefix;    ///< string index
+	boost::uint32_t suffix;    ///< string index
+	boost::uint32_t first;
+	boost::uint32_t last;
+	boost::uint16_t step;
+	boost::uint8_t padding;
+	boost::uint8_t type;       ///< BrowseItemType
+};
+
+/**
+ * Writes the items as a flat file in a single pass over them.
+ * Metadata is not written.
+ */
+SEQUENCEPARSER_API void writeFlat( std::ostream &stream, const BrowseItems &items );
+
+SEQUENCEPARSER_API void writeFlat( const char* filename, const BrowseItems &items );
+
+/**
+ * Read only access to a flat file without decoding it : records and strings
+ * are read where they lie. Opening checks the header, the sizes of the
+ * sections and that records index existing strings, in one pass over them.
+ */
+class SEQUENCEPARSER_API FlatItems : boost::noncopyable
+{
+public:
+	/**
+	 * Memory maps 'filename'
+	 * Throws std::ios_base::failure if it is not a valid flat file of this host
+	 */
+	explicit FlatItems( const char* filename );
+
+	/**
+	 * Reads 'size' bytes at 'data', which must be 4 bytes aligned and
+	 * outlive the object
+	 */
+	FlatItems( const void* data, size_t size );
+
+	~FlatItems();
+
+	size_t size() const
+	{
+		return recordCount;
+	}
+
+	const FlatRecord& record( size_t index ) const
+	{
+		return *reinterpret_cast<const FlatRecord*>( records + index * recordSize );
+	}
+
+	size_t stringCount() const
+	{
+		return strings;
+	}
+
+	boost::string_ref string( boost::uint32_t index ) const
+	{
+		return boost::string_ref( chars + offsets[index], offsets[index + 1] - offsets[index] );
+	}
+
+	/**
+	 * Rebuilds the index-th item
+	 */
+	BrowseItem item( size_t index ) const;
+
+private:
+	void open( const char* data, size_t size );
+
+	struct Mapping;
+	boost::scoped_ptr<Mapping> mapping;
+	size_t recordCount;
+	size_t recordSize;
+	size_t strings;
+	const char* records;
+	const boost::uint32_t* offsets;
+	const char* chars;
+};
+
+}
+}
+
+#endif
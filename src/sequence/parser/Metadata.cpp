@@ -0,0 +1,445 @@
+#include "Metadata.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <cstring>
+
+#if defined( __linux__ ) && !defined( SEQUENCEPARSER_NO_IO_URING ) && defined( STATX_SIZE )
+#define SEQUENCEPARSER_HAS_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+namespace {
+
+/**
+ * Enumerates the filenames of an item without storing them all
+ */
+class FileEnumerator
+{
+public:
+	FileEnumerator( const BrowseItem &item ) :
+		item( &item ),
+		frame( item.sequence.range.first ),
+		done( item.type != SEQUENCE && item.type != UNITFILE )
+	{
+		if( item.type == SEQUENCE )
+		{
+			directory = item.path.string();
+			if( !directory.empty() )
+				directory += '/';
+		}
+	}
+
+	bool next( string &filename )
+	{
+		if( done )
+			return false;
+		if( item->type == UNITFILE )
+		{
+			filename = item->path.string();
+			done = true;
+			return true;
+		}
+		const Sequence &sequence = item->sequence;
+		filename = directory;
+		filename += instanciatePattern( sequence.pattern, frame );
+		const unsigned int step = sequence.step == 0 ? 1 : sequence.step;
+		if( sequence.range.last - frame < step )
+			done = true;
+		else
+			frame += step;
+		return true;
+	}
+
+private:
+	const BrowseItem *item;
+	string directory;
+	unsigned int frame;
+	bool done;
+};
+
+static inline bool needsMetadata( const BrowseItem &item )
+{
+	return item.type == SEQUENCE || item.type == UNITFILE;
+}
+
+static inline void statFile( const char* filename, Metadata &metadata )
+{
+	struct stat buffer;
+	if( ::stat( filename, &buffer ) == 0 )
+		metadata.add( buffer.st_size, buffer.st_mtime );
+}
+
+/**
+ * Returns the number of files stat'ed
+ */
+static size_t statItem( BrowseItem &item )
+{
+	Metadata &metadata = item.sequence.metadata;
+	metadata = Metadata();
+	FileEnumerator enumerator( item );
+	string filename;
+	size_t stats = 0;
+	for( ; enumerator.next( filename ); ++stats )
+		statFile( filename.c_str(), metadata );
+	return stats;
+}
+
+/**
+ * Hands out items to the threads of the pool, a whole item being processed
+ * by a single thread so aggregation needs no synchronization.
+ */
+struct SEQUENCEPARSER_LOCAL ThreadedGatherer
+{
+	ThreadedGatherer( BrowseItems &items ) :
+		items( items ),
+		nextItem( 0 ),
+		stats( 0 )
+	{
+	}
+
+	void operator()()
+	{
+		size_t index;
+		size_t local = 0;
+		while( acquire( index ) )
+			local += statItem( items[index] );
+		boost::lock_guard<boost::mutex> lock( mutex );
+		stats += local;
+	}
+
+	bool acquire( size_t &index )
+	{
+		boost::lock_guard<boost::mutex> lock( mutex );
+		while( nextItem < items.size() && !needsMetadata( items[nextItem] ) )
+			++nextItem;
+		if( nextItem == items.size() )
+			return false;
+		index = nextItem++;
+		return true;
+	}
+
+	BrowseItems &items;
+	size_t nextItem;
+	size_t stats;
+	boost::mutex mutex;
+};
+
+static size_t gatherWithThreads( BrowseItems &items, size_t threads )
+{
+	if( threads == 0 )
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+	ThreadedGatherer gatherer( items );
+	if( threads == 1 )
+	{
+		gatherer();
+		return gatherer.stats;
+	}
+	boost::thread_group group;
+	for( size_t i = 0; i < threads; ++i )
+		group.create_thread( boost::ref( gatherer ) );
+	group.join_all();
+	return gatherer.stats;
+}
+
+#ifdef SEQUENCEPARSER_HAS_IO_URING
+
+/**
+ * Minimal io_uring wrapper talking directly to the kernel
+ */
+class IoUring
+{
+public:
+	explicit IoUring( unsigned int entries ) :
+		fd( -1 ),
+		sqRing( MAP_FAILED ),
+		cqRing( MAP_FAILED ),
+		sqes( MAP_FAILED ),
+		sqRingSize( 0 ),
+		cqRingSize( 0 ),
+		sqesSize( 0 ),
+		capacity( 0 ),
+		pending( 0 )
+	{
+		io_uring_params params;
+		memset( &params, 0, sizeof( params ) );
+		fd = syscall( __NR_io_uring_setup, entries, &params );
+		if( fd < 0 )
+			return;
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof( unsigned int );
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof( io_uring_cqe );
+		const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if( singleMap )
+			sqRingSize = cqRingSize = max( sqRingSize, cqRingSize );
+		sqRing = mmap( NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+		if( sqRing == MAP_FAILED )
+			return;
+		cqRing = singleMap ? sqRing : mmap( NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+		if( cqRing == MAP_FAILED )
+			return;
+		sqesSize = params.sq_entries * sizeof( io_uring_sqe );
+		sqes = mmap( NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+		if( sqes == MAP_FAILED )
+			return;
+
+		char* sq = static_cast<char*>( sqRing );
+		sqTail  = reinterpret_cast<unsigned int*>( sq + params.sq_off.tail );
+		sqMask  = reinterpret_cast<unsigned int*>( sq + params.sq_off.ring_mask );
+		sqArray = reinterpret_cast<unsigned int*>( sq + params.sq_off.array );
+		char* cq = static_cast<char*>( cqRing );
+		cqHead  = reinterpret_cast<unsigned int*>( cq + params.cq_off.head );
+		cqTail  = reinterpret_cast<unsigned int*>( cq + params.cq_off.tail );
+		cqMask  = reinterpret_cast<unsigned int*>( cq + params.cq_off.ring_mask );
+		cqes    = reinterpret_cast<io_uring_cqe*>( cq + params.cq_off.cqes );
+		capacity = params.sq_entries;
+	}
+
+	~IoUring()
+	{
+		if( sqes != MAP_FAILED )
+			munmap( sqes, sqesSize );
+		if( cqRing != MAP_FAILED && cqRing != sqRing )
+			munmap( cqRing, cqRingSize );
+		if( sqRing != MAP_FAILED )
+			munmap( sqRing, sqRingSize );
+		if( fd >= 0 )
+			close( fd );
+	}
+
+	bool valid() const
+	{
+		return sqes != MAP_FAILED;
+	}
+
+	unsigned int size() const
+	{
+		return capacity;
+	}
+
+	/**
+	 * Queues a statx request, submit() must be called before 'size()' requests are queued
+	 */
+	void queueStatx( const char* filename, struct statx *buffer, __u64 userData )
+	{
+		const unsigned int tail = *sqTail + pending;
+		const unsigned int index = tail & *sqMask;
+		io_uring_sqe &sqe = static_cast<io_uring_sqe*>( sqes )[index];
+		memset( &sqe, 0, sizeof( sqe ) );
+		sqe.opcode      = IORING_OP_STATX;
+		sqe.fd          = AT_FDCWD;
+		sqe.addr        = reinterpret_cast<__u64>( filename );
+		sqe.len         = STATX_SIZE | STATX_MTIME;
+		sqe.off         = reinterpret_cast<__u64>( buffer );
+		sqe.statx_flags = 0;
+		sqe.user_data   = userData;
+		sqArray[index] = index;
+		++pending;
+	}
+
+	/**
+	 * Submits the queued requests, waiting for their completion.
+	 * Returns the number of requests the kernel took, all of them unless
+	 * an error occurred.
+	 */
+	unsigned int submitAndWait()
+	{
+		const unsigned int toSubmit = pending;
+		__atomic_store_n( sqTail, *sqTail + pending, __ATOMIC_RELEASE );
+		pending = 0;
+		unsigned int submitted = 0;
+		while( submitted < toSubmit )
+		{
+			const int result = syscall( __NR_io_uring_enter, fd, toSubmit - submitted, toSubmit - submitted, IORING_ENTER_GETEVENTS, NULL, 0 );
+			if( result < 0 )
+			{
+				if( errno == EINTR )
+					continue;
+				break;
+			}
+			submitted += result;
+		}
+		return submitted;
+	}
+
+	/**
+	 * Blocks until at least one completion is available
+	 */
+	bool wait()
+	{
+		for( ;; )
+		{
+			if( syscall( __NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0 ) >= 0 )
+				return true;
+			if( errno != EINTR )
+				return false;
+		}
+	}
+
+	/**
+	 * Pops a completion, returns false if none is available
+	 */
+	bool pop( __u64 &userData, int &result )
+	{
+		const unsigned int head = *cqHead;
+		if( head == __atomic_load_n( cqTail, __ATOMIC_ACQUIRE ) )
+			return false;
+		const io_uring_cqe &cqe = cqes[head & *cqMask];
+		userData = cqe.user_data;
+		result = cqe.res;
+		__atomic_store_n( cqHead, head + 1, __ATOMIC_RELEASE );
+		return true;
+	}
+
+private:
+	int fd;
+	void *sqRing, *cqRing, *sqes;
+	size_t sqRingSize, cqRingSize, sqesSize;
+	unsigned int *sqTail, *sqMask, *sqArray;
+	unsigned int *cqHead, *cqTail, *cqMask;
+	io_uring_cqe *cqes;
+	unsigned int capacity;
+	unsigned int pending;
+
+	IoUring( const IoUring& );
+	IoUring& operator=( const IoUring& );
+};
+
+struct StatxSlot
+{
+	size_t item;
+	string filename;
+	struct statx buffer;
+};
+
+/**
+ * Adds the number of files stat'ed to 'stats'
+ */
+/**
+ * The kernel may still write to the buffers of requests in flight once the
+ * ring is closed : they are leaked rather than freed under it
+ */
+static void abandon( vector<StatxSlot> &slots )
+{
+	( new vector<StatxSlot>() )->swap( slots );
+}
+
+static bool gatherWithIoUring( BrowseItems &items, size_t &stats )
+{
+	// declared first so the buffers outlive the ring
+	vector<StatxSlot> slots;
+	IoUring ring( 256 );
+	if( !ring.valid() )
+		return false;
+	slots.resize( ring.size() );
+
+	size_t itemIndex = 0;
+	for( ; itemIndex < items.size() && !needsMetadata( items[itemIndex] ); ++itemIndex )
+		;
+	if( itemIndex == items.size() )
+		return true;
+	items[itemIndex].sequence.metadata = Metadata();
+	FileEnumerator enumerator( items[itemIndex] );
+	bool exhausted = false;
+
+	while( !exhausted )
+	{
+		// filling a batch
+		size_t queued = 0;
+		while( queued < slots.size() )
+		{
+			StatxSlot &slot = slots[queued];
+			if( enumerator.next( slot.filename ) )
+			{
+				slot.item = itemIndex;
+				ring.queueStatx( slot.filename.c_str(), &slot.buffer, queued );
+				++queued;
+				continue;
+			}
+			for( ++itemIndex; itemIndex < items.size() && !needsMetadata( items[itemIndex] ); ++itemIndex )
+				;
+			if( itemIndex == items.size() )
+			{
+				exhausted = true;
+				break;
+			}
+			items[itemIndex].sequence.metadata = Metadata();
+			enumerator = FileEnumerator( items[itemIndex] );
+		}
+		if( queued == 0 )
+			break;
+		stats += queued;
+		const unsigned int submitted = ring.submitAndWait();
+		// aggregating the batch, every submitted request being reaped before giving up
+		__u64 userData;
+		int result;
+		for( size_t reaped = 0; reaped < submitted; ++reaped )
+		{
+			while( !ring.pop( userData, result ) )
+			{
+				if( !ring.wait() )
+				{
+					abandon( slots );
+					return false;
+				}
+			}
+			const StatxSlot &slot = slots[userData];
+			Metadata &metadata = items[slot.item].sequence.metadata;
+			if( result == 0 )
+				metadata.add( slot.buffer.stx_size, slot.buffer.stx_mtime.tv_sec );
+			else if( result == -EINVAL || result == -EOPNOTSUPP )
+			{
+				statFile( slot.filename.c_str(), metadata ); // kernel without IORING_OP_STATX
+				++stats;
+			}
+		}
+		if( submitted < queued )
+			return false;
+	}
+	return true;
+}
+
+#endif
+
+}
+
+bool ioUringAvailable()
+{
+#ifdef SEQUENCEPARSER_HAS_IO_URING
+	return IoUring( 1 ).valid();
+#else
+	return false;
+#endif
+}
+
+size_t gatherMetadata( BrowseItems &items, MetadataBackend backend, size_t threads )
+{
+#ifdef SEQUENCEPARSER_HAS_IO_URING
+	size_t stats = 0;
+	if( backend != METADATA_THREADS && gatherWithIoUring( items, stats ) )
+		return stats;
+	// a failing ring stats everything again
+	return stats + gatherWithThreads( items, threads );
+#else
+	return gatherWithThreads( items, threads );
+#endif
+}
+
+}
+}
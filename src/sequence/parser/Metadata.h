@@ -0,0 +1,48 @@
+/*
+ * Metadata.h
+ *
+ * Gathering of size and modification time for browsed items.
+ */
+
+#ifndef METADATA_H_
+#define METADATA_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * How the files are stat'ed
+ */
+enum MetadataBackend
+{
+	METADATA_AUTO,     ///< io_uring if available, threads otherwise
+	METADATA_IO_URING, ///< batched statx through io_uring, falls back to threads if unavailable
+	METADATA_THREADS   ///< a pool of threads calling stat
+};
+
+/**
+ * Stats every file of the items and aggregates the total size as well as the
+ * oldest and newest modification times into item.sequence.metadata.
+ * No per file record is kept : a Sequence of N frames costs N stats but
+ * only one Metadata.
+ * FOLDER and UNDEFINED items are left untouched.
+ *
+ * 'threads' is the size of the thread pool, 0 meaning one per core.
+ * Returns the number of stat calls issued.
+ */
+SEQUENCEPARSER_API size_t gatherMetadata( BrowseItems &items, MetadataBackend backend = METADATA_AUTO, size_t threads = 0 );
+
+/**
+ * Tells whether the io_uring backend can be used on this system
+ */
+SEQUENCEPARSER_API bool ioUringAvailable();
+
+}
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include "NaturalSort.h"
+
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+namespace {
+
+/**
+ * Below this size sorting in a single thread is faster
+ */
+const size_t gParallelThreshold = 8192;
+
+/**
+ * Replaces the directory separators of the item keys so a sub directory
+ * sorts before any sibling extending its name, e.g. "a/x" before "a b"
+ */
+const char gPathSeparator = '\1';
+
+inline bool isDigit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+/**
+ * Copies the characters, a run of digits being written as '0', a byte
+ * holding its number of significant digits, then these digits : runs
+ * compare by value and sort among the other characters as digits do.
+ */
+void appendNaturalKey( string &key, const string &value )
+{
+	const char* itr = value.data();
+	const char* const end = itr + value.size();
+	while( itr != end )
+	{
+		if( !isDigit( *itr ) )
+		{
+			key += *itr++;
+			continue;
+		}
+		while( itr != end && *itr == '0' )
+			++itr;
+		const char* digits = itr;
+		while( itr != end && isDigit( *itr ) )
+			++itr;
+		key += '0';
+		key += static_cast<char>( '0' + min<size_t>( itr - digits, 200 ) );
+		key.append( digits, itr );
+	}
+}
+
+/**
+ * Directory and name in natural order, then as written so keys are unique
+ * within a browse result and ties never depend on the initial order.
+ * The '\0' ending the directory puts its files before its sub directories.
+ */
+string itemKey( const BrowseItem &item )
+{
+	string directory;
+	string name;
+	if( item.type == SEQUENCE )
+	{
+		directory = item.path.string();
+		name = instanciatePattern( item.sequence.pattern, item.sequence.range.first );
+	}
+	else
+	{
+		directory = item.path.parent_path().string();
+		name = item.path.filename().string();
+	}
+	string key;
+	key.reserve( 2 * ( directory.size() + name.size() ) + 8 );
+	appendNaturalKey( key, directory );
+	// digit counts are written from '0' and can't be taken for a separator
+	replace( key.begin(), key.end(), '/', gPathSeparator );
+	key += '\0';
+	appendNaturalKey( key, name );
+	key += '\0';
+	key += directory;
+	key += '\0';
+	key += name;
+	return key;
+}
+
+/**
+ * The eight bytes following the prefix common to all the keys are compared
+ * as an integer, most entries being ordered without reading their key
+ */
+struct SEQUENCEPARSER_LOCAL SortEntry
+{
+	boost::uint64_t head;
+	size_t index;
+};
+
+struct SEQUENCEPARSER_LOCAL EntryLess
+{
+	EntryLess( const vector<string> &keys ) :
+		keys( &keys )
+	{
+	}
+
+	bool operator()( const SortEntry &a, const SortEntry &b ) const
+	{
+		if( a.head != b.head )
+			return a.head < b.head;
+		return ( *keys )[a.index] < ( *keys )[b.index];
+	}
+
+	const vector<string> *keys;
+};
+
+/**
+ * Computes the keys of a chunk of items
+ */
+struct SEQUENCEPARSER_LOCAL KeyBuilder
+{
+	KeyBuilder( const BrowseItems &items, vector<string> &keys ) :
+		items( items ),
+		keys( keys )
+	{
+	}
+
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin; i < end; ++i )
+			keys[i] = itemKey( items[i] );
+	}
+
+	const BrowseItems &items;
+	vector<string> &keys;
+};
+
+/**
+ * Fills the entries of a chunk of keys and sorts them
+ */
+struct SEQUENCEPARSER_LOCAL ChunkSorter
+{
+	ChunkSorter( const vector<string> &keys, size_t common, vector<SortEntry> &entries ) :
+		keys( keys ),
+		common( common ),
+		entries( entries )
+	{
+	}
+
+	void operator()( size_t begin, size_t end ) const
+	{
+		for( size_t i = begin; i < end; ++i )
+		{
+			const string &key = keys[i];
+			boost::uint64_t head = 0;
+			for( size_t byte = common; byte < common + 8; ++byte )
+				head = ( head << 8 ) | ( byte < key.size() ? static_cast<unsigned char>( key[byte] ) : 0 );
+			entries[i].head = head;
+			entries[i].index = i;
+		}
+		sort( entries.begin() + begin, entries.begin() + end, EntryLess( keys ) );
+	}
+
+	const vector<string> &keys;
+	const size_t common;
+	vector<SortEntry> &entries;
+};
+
+/**
+ * The size of the prefix shared by all the keys, usually the browsed directory
+ */
+size_t commonPrefix( const vector<string> &keys )
+{
+	if( keys.empty() )
+		return 0;
+	const string &first = keys.front();
+	size_t common = first.size();
+	for( vector<string>::const_iterator itr = keys.begin() + 1; itr != keys.end() && common; ++itr )
+		common = mismatch( first.begin(), first.begin() + min( common, itr->size() ), itr->begin() ).first - first.begin();
+	return common;
+}
+
+/**
+ * Runs 'function' on each chunk, chunk i being [ bounds[i], bounds[i + 1] )
+ */
+template<typename Function>
+void forEachChunk( const Function &function, const vector<size_t> &bounds )
+{
+	const size_t chunks = bounds.size() - 1;
+	if( chunks == 1 )
+	{
+		function( bounds[0], bounds[1] );
+		return;
+	}
+	boost::thread_group group;
+	for( size_t i = 0; i < chunks; ++i )
+		group.create_thread( boost::bind<void>( boost::cref( function ), bounds[i], bounds[i + 1] ) );
+	group.join_all();
+}
+
+void mergeChunks( vector<SortEntry> &entries, size_t begin, size_t middle, size_t end, const vector<string> &keys )
+{
+	inplace_merge( entries.begin() + begin, entries.begin() + middle, entries.begin() + end, EntryLess( keys ) );
+}
+
+void takeOver( BrowseItem &from, BrowseItem &to )
+{
+	to.type = from.type;
+	to.path.swap( from.path );
+	to.sequence.pattern.prefix.swap( from.sequence.pattern.prefix );
+	to.sequence.pattern.suffix.swap( from.sequence.pattern.suffix );
+	to.sequence.pattern.padding = from.sequence.pattern.padding;
+	to.sequence.range = from.sequence.range;
+	to.sequence.step = from.sequence.step;
+	to.sequence.metadata = from.sequence.metadata;
+}
+
+}
+
+string naturalKey( const string &value )
+{
+	string key;
+	appendNaturalKey( key, value );
+	return key;
+}
+
+bool naturalLess( const string &a, const string &b )
+{
+	return naturalKey( a ) < naturalKey( b );
+}
+
+void sortItems( BrowseItems &items, size_t threads )
+{
+	const size_t size = items.size();
+	if( threads == 0 )
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+	if( size < gParallelThreshold )
+		threads = 1;
+
+	vector<string> keys( size );
+	vector<SortEntry> entries( size );
+	vector<size_t> bounds;
+	for( size_t i = 0; i <= threads; ++i )
+		bounds.push_back( size * i / threads );
+	forEachChunk( KeyBuilder( items, keys ), bounds );
+	forEachChunk( ChunkSorter( keys, commonPrefix( keys ), entries ), bounds );
+	// sorted chunks are merged pairwise, the merges of a level running concurrently
+	for( size_t width = 1; width < threads; width *= 2 )
+	{
+		boost::thread_group group;
+		for( size_t i = 0; i + width < threads; i += 2 * width )
+			group.create_thread( boost::bind( &mergeChunks, boost::ref( entries ), bounds[i], bounds[i + width], bounds[min( i + 2 * width, threads )], boost::cref( keys ) ) );
+		group.join_all();
+	}
+
+	BrowseItems sorted( size );
+	for( size_t i = 0; i < size; ++i )
+		takeOver( items[entries[i].index], sorted[i] );
+	items.swap( sorted );
+}
+
+}
+}
@@ -0,0 +1,43 @@
+/*
+ * NaturalSort.h
+ *
+ * Deterministic, numeric aware ordering of the browse results.
+ */
+
+#ifndef NATURALSORT_H_
+#define NATURALSORT_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <string>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * A string whose byte order is the natural order of 'value' : runs of
+ * digits compare by value so "shot2" comes before "shot10".
+ * Equal numbers written with different leading zeros give the same key.
+ */
+SEQUENCEPARSER_API std::string naturalKey( const std::string &value );
+
+SEQUENCEPARSER_API bool naturalLess( const std::string &a, const std::string &b );
+
+/**
+ * Sorts the items by directory, then by name, in natural order. A sequence
+ * is named after its first file, files of a directory come before the
+ * content of its sub directories and the order is the same whatever the
+ * initial order of the items.
+ *
+ * Keys are computed once per item. Vectors larger than a few thousand
+ * items are sorted by 'threads' threads, 0 meaning one per core.
+ */
+SEQUENCEPARSER_API void sortItems( BrowseItems &items, size_t threads = 0 );
+
+}
+}
+
+#endif
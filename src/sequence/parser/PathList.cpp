@@ -0,0 +1,186 @@
+#include "PathList.h"
+#include "Statistics.h"
+#include "details/Utils.h"
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <cstring>
+
+using namespace std;
+using namespace sequence::parser::details;
+
+namespace sequence {
+namespace parser {
+
+namespace {
+
+typedef vector<boost::string_ref> Lines;
+
+/**
+ * Splits a chunk of the buffer into lines, bucketed by a hash of their
+ * parent directory so a directory is always parsed by the same shard
+ */
+struct SEQUENCEPARSER_LOCAL Splitter
+{
+	Splitter( const char* begin, const char* end, size_t shards ) :
+		begin( begin ),
+		end( end ),
+		buckets( shards )
+	{
+	}
+
+	void operator()()
+	{
+		const char* current = begin;
+		while( current < end )
+		{
+			const char* lineEnd = static_cast<const char*>( memchr( current, '\n', end - current ) );
+			if( lineEnd == NULL )
+				lineEnd = end;
+			boost::string_ref line( current, lineEnd - current );
+			if( !line.empty() && line[line.size() - 1] == '\r' )
+				line.remove_suffix( 1 );
+			while( line.size() > 1 && ( line[line.size() - 1] == '/' || line[line.size() - 1] == '\\' ) )
+				line.remove_suffix( 1 );
+			if( !line.empty() )
+			{
+				size_t separator = line.find_last_of( "/\\" );
+				if( separator == boost::string_ref::npos )
+					separator = 0;
+				const size_t hash = boost::hash_range( line.begin(), line.begin() + separator );
+				buckets[hash % buckets.size()].push_back( line );
+			}
+			current = lineEnd + 1;
+		}
+	}
+
+	const char* begin;
+	const char* end;
+	vector<Lines> buckets;
+};
+
+/**
+ * Parses the lines of one shard from every chunk
+ */
+struct SEQUENCEPARSER_LOCAL Shard
+{
+	Shard( const vector<Splitter> &splitters, size_t index, bool withStatistics ) :
+		splitters( splitters ),
+		index( index ),
+		withStatistics( withStatistics )
+	{
+	}
+
+	void operator()()
+	{
+		parser.setStatistics( withStatistics ? &statistics : NULL );
+		for( vector<Splitter>::const_iterator itr = splitters.begin(); itr != splitters.end(); ++itr )
+		{
+			const Lines &lines = itr->buckets[index];
+			for( Lines::const_iterator line = lines.begin(); line != lines.end(); ++line )
+				parser.insert( *line );
+		}
+		parser.releaseResults( items );
+	}
+
+	const vector<Splitter> &splitters;
+	size_t index;
+	bool withStatistics;
+	Parser parser;
+	Statistics statistics;
+	BrowseItems items;
+};
+
+template<typename Task>
+static void runAll( vector<Task> &tasks )
+{
+	if( tasks.size() == 1 )
+	{
+		tasks.front()();
+		return;
+	}
+	boost::thread_group group;
+	for( size_t i = 0; i < tasks.size(); ++i )
+		group.create_thread( boost::ref( tasks[i] ) );
+	group.join_all();
+}
+
+}
+
+BrowseItems parseLines( const char* begin, const char* end, size_t threads, Statistics *statistics )
+{
+	if( threads == 0 )
+	{
+		// not worth a thread below this size
+		const size_t minChunk = 1 << 20;
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+		threads = max( size_t( 1 ), min( threads, size_t( end - begin ) / minChunk ) );
+	}
+
+	// chunks are cut on line boundaries
+	vector<Splitter> splitters;
+	splitters.reserve( threads );
+	const char* chunkBegin = begin;
+	for( size_t i = 1; i <= threads && chunkBegin < end; ++i )
+	{
+		const char* chunkEnd = i == threads ? end : begin + ( end - begin ) * i / threads;
+		if( chunkEnd < chunkBegin )
+			chunkEnd = chunkBegin;
+		const char* newline = static_cast<const char*>( memchr( chunkEnd, '\n', end - chunkEnd ) );
+		chunkEnd = newline ? newline + 1 : end;
+		splitters.push_back( Splitter( chunkBegin, chunkEnd, threads ) );
+		chunkBegin = chunkEnd;
+	}
+	if( splitters.empty() )
+		return BrowseItems();
+	{
+		// reading the list stands for reading the directories
+		ScopedTimer timer( statistics, &Statistics::readdirTime );
+		runAll( splitters );
+	}
+
+	vector<Shard> shards;
+	shards.reserve( threads );
+	for( size_t i = 0; i < threads; ++i )
+		shards.push_back( Shard( splitters, i, statistics != NULL ) );
+	runAll( shards );
+
+	BrowseItems items;
+	items.swap( shards.front().items );
+	for( size_t i = 0; i < shards.size(); ++i )
+	{
+		if( i )
+			items.insert( items.end(), shards[i].items.begin(), shards[i].items.end() );
+		if( statistics )
+			*statistics += shards[i].statistics;
+	}
+	return items;
+}
+
+BrowseItems parseList( const char* filename, size_t threads, Statistics *statistics )
+{
+	if( strcmp( filename, "-" ) == 0 )
+	{
+		// a pipe can't be mapped
+		const string content( ( istreambuf_iterator<char>( cin ) ), istreambuf_iterator<char>() );
+		return parseLines( content.data(), content.data() + content.size(), threads, statistics );
+	}
+	if( boost::filesystem::file_size( filename ) == 0 )
+		return BrowseItems();
+	using namespace boost::interprocess;
+	const file_mapping file( filename, read_only );
+	const mapped_region region( file, read_only );
+	const char* data = static_cast<const char*>( region.get_address() );
+	return parseLines( data, data + region.get_size(), threads, statistics );
+}
+
+}
+}
@@ -0,0 +1,40 @@
+/*
+ * PathList.h
+ *
+ * Parsing of path listings without accessing the listed files.
+ */
+
+#ifndef PATHLIST_H_
+#define PATHLIST_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+namespace sequence
+{
+namespace parser
+{
+
+struct Statistics;
+
+/**
+ * Groups the newline separated paths of [begin, end) as browse() would,
+ * but no file is accessed : every non sequence path is reported as a
+ * UNITFILE. Empty lines are skipped, trailing separators and '\r' are
+ * ignored.
+ *
+ * Lines are sharded by parent directory and parsed by 'threads' threads,
+ * 0 meaning one per core. Results are grouped by directory.
+ */
+SEQUENCEPARSER_API BrowseItems parseLines( const char* begin, const char* end, size_t threads = 0, Statistics *statistics = NULL );
+
+/**
+ * Same as parseLines() on the content of 'filename', memory mapped.
+ * "-" reads the standard input.
+ */
+SEQUENCEPARSER_API BrowseItems parseList( const char* filename, size_t threads = 0, Statistics *statistics = NULL );
+
+}
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include "SequenceIndex.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+namespace {
+
+const boost::uint32_t gEnd = numeric_limits<boost::uint32_t>::max();
+const char gSeparator = '\0';
+
+inline bool isDigit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+inline bool isSeparator( char c )
+{
+	return c == '/' || c == '\\';
+}
+
+const boost::uint64_t gFnvOffset = 14695981039346656037ULL;
+const boost::uint64_t gFnvPrime = 1099511628211ULL;
+
+/**
+ * FNV-1a of [begin, end) continued from 'hash' : a string hashed in pieces
+ * gives the hash of the whole string
+ */
+inline boost::uint64_t fnv1a( boost::uint64_t hash, const char* begin, const char* end )
+{
+	for( ; begin != end; ++begin )
+		hash = ( hash ^ static_cast<unsigned char>( *begin ) ) * gFnvPrime;
+	return hash;
+}
+
+/**
+ * A key split around the frame number, hashed as the concatenated string
+ */
+struct SplitKey
+{
+	boost::string_ref head;
+	boost::string_ref tail;
+};
+
+struct SplitKeyHash
+{
+	size_t operator()( const SplitKey &key ) const
+	{
+		boost::uint64_t hash = fnv1a( gFnvOffset, key.head.begin(), key.head.end() );
+		hash = fnv1a( hash, &gSeparator, &gSeparator + 1 );
+		return static_cast<size_t>( fnv1a( hash, key.tail.begin(), key.tail.end() ) );
+	}
+};
+
+struct SplitKeyEqual
+{
+	bool operator()( const SplitKey &key, const string &value ) const
+	{
+		const boost::string_ref ref( value );
+		return ref.size() == key.head.size() + 1 + key.tail.size() &&
+			   ref.starts_with( key.head ) &&
+			   ref[key.head.size()] == gSeparator &&
+			   ref.ends_with( key.tail );
+	}
+};
+
+}
+
+const size_t SequenceIndex::npos;
+
+size_t SequenceIndex::KeyHash::operator()( const string &key ) const
+{
+	return static_cast<size_t>( fnv1a( gFnvOffset, key.data(), key.data() + key.size() ) );
+}
+
+SequenceIndex::SequenceIndex( const BrowseItems &items )
+{
+	string key;
+	for( size_t i = 0; i < items.size(); ++i )
+	{
+		const BrowseItem &item = items[i];
+		if( item.type != SEQUENCE )
+			continue;
+		const Sequence &sequence = item.sequence;
+		key = item.path.string();
+		if( !key.empty() && !isSeparator( key[key.size() - 1] ) )
+			key += boost::filesystem::path::preferred_separator;
+		key += sequence.pattern.prefix;
+		key += gSeparator;
+		key += sequence.pattern.suffix;
+
+		const pair<Keys::iterator, bool> inserted = keys.insert( make_pair( key, gEnd ) );
+		const Entry entry = { i, sequence.range.first, sequence.range.last, sequence.step, sequence.pattern.padding, inserted.first->second };
+		inserted.first->second = static_cast<boost::uint32_t>( entries.size() );
+		entries.push_back( entry );
+	}
+}
+
+bool SequenceIndex::matches( const Entry &entry, const boost::string_ref digits ) const
+{
+	// padded to the width, wider numbers having no leading zero, as PatternMatcher accepts them
+	if( digits.size() < entry.padding || ( digits.size() > max( boost::uint8_t( 1 ), entry.padding ) && digits[0] == '0' ) )
+		return false;
+	if( digits.size() > 10 )
+		return false;
+	boost::uint64_t frame = 0;
+	for( boost::string_ref::const_iterator itr = digits.begin(); itr != digits.end(); ++itr )
+		frame = frame * 10 + ( *itr - '0' );
+	if( frame > numeric_limits<boost::uint32_t>::max() )
+		return false;
+	return entry.first <= frame && frame <= entry.last && ( frame - entry.first ) % max( boost::uint16_t( 1 ), entry.step ) == 0;
+}
+
+size_t SequenceIndex::find( const boost::string_ref path ) const
+{
+	if( keys.empty() )
+		return npos;
+	size_t filenameBegin = path.size();
+	while( filenameBegin > 0 && !isSeparator( path[filenameBegin - 1] ) )
+		--filenameBegin;
+	// frames are usually the last number of the filename
+	size_t end = path.size();
+	while( end > filenameBegin )
+	{
+		if( !isDigit( path[end - 1] ) )
+		{
+			--end;
+			continue;
+		}
+		size_t begin = end - 1;
+		while( begin > filenameBegin && isDigit( path[begin - 1] ) )
+			--begin;
+		const SplitKey key = { path.substr( 0, begin ), path.substr( end ) };
+		const Keys::const_iterator found = keys.find( key, SplitKeyHash(), SplitKeyEqual() );
+		if( found != keys.end() )
+		{
+			const boost::string_ref digits = path.substr( begin, end - begin );
+			for( boost::uint32_t index = found->second; index != gEnd; index = entries[index].next )
+				if( matches( entries[index], digits ) )
+					return entries[index].item;
+		}
+		end = begin;
+	}
+	return npos;
+}
+
+namespace {
+
+struct SEQUENCEPARSER_LOCAL BatchFinder
+{
+	BatchFinder( const SequenceIndex &index, const vector<string> &paths, vector<size_t> &results, size_t begin, size_t end ) :
+		index( index ),
+		paths( paths ),
+		results( results ),
+		begin( begin ),
+		end( end )
+	{
+	}
+
+	void operator()() const
+	{
+		for( size_t i = begin; i < end; ++i )
+			results[i] = index.find( paths[i] );
+	}
+
+	const SequenceIndex &index;
+	const vector<string> &paths;
+	vector<size_t> &results;
+	size_t begin;
+	size_t end;
+};
+
+}
+
+vector<size_t> SequenceIndex::find( const vector<string> &paths, size_t threads ) const
+{
+	vector<size_t> results( paths.size(), npos );
+	if( threads == 0 )
+		threads = max( 1u, boost::thread::hardware_concurrency() );
+	// not worth a thread below this count
+	const size_t minPaths = 4096;
+	threads = max( size_t( 1 ), min( threads, paths.size() / minPaths ) );
+	if( threads == 1 )
+	{
+		BatchFinder( *this, paths, results, 0, paths.size() )();
+		return results;
+	}
+	boost::thread_group group;
+	for( size_t i = 0; i < threads; ++i )
+		group.create_thread( BatchFinder( *this, paths, results, paths.size() * i / threads, paths.size() * ( i + 1 ) / threads ) );
+	group.join_all();
+	return results;
+}
+
+}
+}
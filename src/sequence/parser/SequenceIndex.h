@@ -0,0 +1,88 @@
+/*
+ * SequenceIndex.h
+ *
+ * Reverse lookup of the sequence a file belongs to.
+ */
+
+#ifndef SEQUENCEINDEX_H_
+#define SEQUENCEINDEX_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <string>
+#include <vector>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * Finds which SEQUENCE item of a browse result a path belongs to.
+ *
+ * Sequences are hashed on their directory, prefix and suffix so a lookup
+ * costs one hash per number in the filename, whatever the number of items.
+ * Paths must be spelled like the browsed directory : "/x/y/a.0042.exr"
+ * is found in the results of browse( "/x/y" ), not of browse( "/x/y/" ).
+ */
+class SEQUENCEPARSER_API SequenceIndex
+{
+public:
+	static const size_t npos = static_cast<size_t>( -1 );
+
+	explicit SequenceIndex( const BrowseItems &items );
+
+	/**
+	 * The index in 'items' of the sequence holding 'path', npos if none does
+	 */
+	size_t find( const boost::string_ref path ) const;
+
+	bool contains( const boost::string_ref path ) const
+	{
+		return find( path ) != npos;
+	}
+
+	/**
+	 * find() for each path, 'threads' share the work, 0 meaning one per core
+	 */
+	std::vector<size_t> find( const std::vector<std::string> &paths, size_t threads = 0 ) const;
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+private:
+	struct Entry
+	{
+		size_t item;
+		boost::uint32_t first;
+		boost::uint32_t last;
+		boost::uint16_t step;
+		boost::uint8_t padding;
+		boost::uint32_t next; ///< next entry with the same key
+	};
+
+	struct KeyHash
+	{
+		size_t operator()( const std::string &key ) const;
+	};
+
+	/// key is the sequence path up to the frame, a '\0' then the suffix
+	typedef boost::unordered_map<std::string, boost::uint32_t, KeyHash> Keys;
+
+	bool matches( const Entry &entry, const boost::string_ref digits ) const;
+
+	Keys keys;
+	std::vector<Entry> entries;
+};
+
+}
+}
+
+#endif
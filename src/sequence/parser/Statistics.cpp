@@ -0,0 +1,86 @@
+#include "Statistics.h"
+
+#include <iomanip>
+
+using namespace std;
+
+namespace sequence {
+namespace parser {
+
+Statistics::Statistics()
+{
+	reset();
+}
+
+void Statistics::reset()
+{
+	readdirTime = extractTime = lookupTime = prepareTime = splitTime = resultsTime = typeTime = metadataTime = sortTime = 0;
+	syscalls = directories = entries = patterns = splits = results = bytesAllocated = 0;
+}
+
+boost::uint64_t Statistics::totalTime() const
+{
+	return readdirTime + extractTime + lookupTime + prepareTime + splitTime + resultsTime + typeTime + metadataTime + sortTime;
+}
+
+Statistics& Statistics::operator+=( const Statistics &other )
+{
+	readdirTime    += other.readdirTime;
+	extractTime    += other.extractTime;
+	lookupTime     += other.lookupTime;
+	prepareTime    += other.prepareTime;
+	splitTime      += other.splitTime;
+	resultsTime    += other.resultsTime;
+	typeTime       += other.typeTime;
+	metadataTime   += other.metadataTime;
+	sortTime       += other.sortTime;
+	syscalls       += other.syscalls;
+	directories    += other.directories;
+	entries        += other.entries;
+	patterns       += other.patterns;
+	splits         += other.splits;
+	results        += other.results;
+	bytesAllocated += other.bytesAllocated;
+	return *this;
+}
+
+static void printTime( ostream &stream, const char* name, boost::uint64_t nanoseconds )
+{
+	stream << "  " << left << setw( 10 ) << name << right << setw( 12 ) << fixed << setprecision( 3 ) << nanoseconds / 1e6 << " ms\n";
+}
+
+static void printCount( ostream &stream, const char* name, boost::uint64_t count )
+{
+	stream << "  " << left << setw( 16 ) << name << right << setw( 10 ) << count << '\n';
+}
+
+ostream& operator<<( ostream &stream, const Statistics &statistics )
+{
+	const ios_base::fmtflags flags = stream.flags();
+	const streamsize precision = stream.precision();
+	stream << "Phases\n";
+	printTime( stream, "readdir", statistics.readdirTime );
+	printTime( stream, "extract", statistics.extractTime );
+	printTime( stream, "lookup", statistics.lookupTime );
+	printTime( stream, "prepare", statistics.prepareTime );
+	printTime( stream, "split", statistics.splitTime );
+	printTime( stream, "results", statistics.resultsTime );
+	printTime( stream, "type", statistics.typeTime );
+	printTime( stream, "metadata", statistics.metadataTime );
+	printTime( stream, "sort", statistics.sortTime );
+	printTime( stream, "total", statistics.totalTime() );
+	stream << "Counters\n";
+	printCount( stream, "syscalls", statistics.syscalls );
+	printCount( stream, "directories", statistics.directories );
+	printCount( stream, "entries", statistics.entries );
+	printCount( stream, "patterns", statistics.patterns );
+	printCount( stream, "splits", statistics.splits );
+	printCount( stream, "results", statistics.results );
+	printCount( stream, "bytes allocated", statistics.bytesAllocated );
+	stream.flags( flags );
+	stream.precision( precision );
+	return stream;
+}
+
+}
+}
@@ -0,0 +1,94 @@
+/*
+ * Statistics.h
+ *
+ * Opt-in instrumentation of the browse operation.
+ */
+
+#ifndef STATISTICS_H_
+#define STATISTICS_H_
+
+#include <sequence/Config.h>
+
+#include <boost/chrono/chrono.hpp>
+#include <boost/cstdint.hpp>
+
+#include <ostream>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * Counters and per phase wall times filled by browse() and details::Parser
+ * when given one. Times are in nanoseconds.
+ */
+struct SEQUENCEPARSER_API Statistics
+{
+	boost::uint64_t readdirTime;  ///< listing the directories
+	boost::uint64_t extractTime;  ///< extracting the patterns from the filenames
+	boost::uint64_t lookupTime;   ///< finding the patterns in the hash maps
+	boost::uint64_t prepareTime;  ///< sorting the values and baking the constant locations
+	boost::uint64_t splitTime;    ///< splitting the patterns having several varying locations
+	boost::uint64_t resultsTime;  ///< detecting the ranges and creating the items
+	boost::uint64_t typeTime;     ///< checking which unit files are folders
+	boost::uint64_t metadataTime; ///< gathering the files metadata
+	boost::uint64_t sortTime;     ///< sorting the items in natural order
+
+	boost::uint64_t syscalls;       ///< filesystem calls issued : directory opening, entry reading and stat
+	boost::uint64_t directories;    ///< directories opened
+	boost::uint64_t entries;        ///< entries inserted in the parser
+	boost::uint64_t patterns;       ///< patterns created, including the ones created by splits
+	boost::uint64_t splits;         ///< patterns split
+	boost::uint64_t results;        ///< items returned
+	boost::uint64_t bytesAllocated; ///< estimated from the capacity of the parser containers
+
+	Statistics();
+
+	void reset();
+
+	boost::uint64_t totalTime() const;
+
+	Statistics& operator+=( const Statistics &other );
+};
+
+SEQUENCEPARSER_API std::ostream& operator<<( std::ostream &stream, const Statistics &statistics );
+
+namespace details
+{
+
+/**
+ * Adds the time spent in its scope to a Statistics field.
+ * Does not even read the clock if no Statistics is given.
+ */
+class ScopedTimer
+{
+public:
+	typedef boost::chrono::high_resolution_clock Clock;
+
+	ScopedTimer( Statistics *statistics, boost::uint64_t Statistics::*field ) :
+		statistics( statistics ),
+		field( field )
+	{
+		if( statistics )
+			start = Clock::now();
+	}
+
+	~ScopedTimer()
+	{
+		if( statistics )
+			statistics->*field += boost::chrono::duration_cast<boost::chrono::nanoseconds>( Clock::now() - start ).count();
+	}
+
+private:
+	Statistics *statistics;
+	boost::uint64_t Statistics::*field;
+	Clock::time_point start;
+};
+
+}
+
+}
+}
+
+#endif
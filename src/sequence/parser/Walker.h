@@ -0,0 +1,67 @@
+/*
+ * Walker.h
+ *
+ * Incremental browsing, one directory at a time.
+ */
+
+#ifndef WALKER_H_
+#define WALKER_H_
+
+#include <sequence/Config.h>
+#include <sequence/parser/Browser.h>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <vector>
+
+namespace sequence
+{
+namespace parser
+{
+
+/**
+ * Browses a tree directory by directory so results are available as soon
+ * as a directory is done and only one directory is held in memory.
+ * Symbolic links to directories are reported, and followed if
+ * options.followSymlinks is set.
+ *
+ * Walker walker( "/shows" , options );
+ * BrowseItems items;
+ * while( walker.next( items ) )
+ *     process( walker.directory(), items );
+ */
+class SEQUENCEPARSER_API Walker : boost::noncopyable
+{
+public:
+	/**
+	 * Sub directories are only visited if options.recursive is set
+	 */
+	Walker( const char* directory, const BrowseOptions &options = BrowseOptions() );
+
+	/**
+	 * Replaces 'items' by the content of the next directory.
+	 * Returns false once every directory was browsed.
+	 */
+	bool next( BrowseItems &items );
+
+	/**
+	 * The directory browsed by the last call to next()
+	 */
+	const boost::filesystem::path& directory() const
+	{
+		return current;
+	}
+
+private:
+	BrowseOptions options;
+	bool recursive;
+	std::vector<boost::filesystem::path> pending; ///< used as a stack
+	DirectoryIds visited; ///< only filled when following links
+	boost::filesystem::path current;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,216 @@
+/*
+ * StringMap.h
+ *
+ * Open addressing hash map keyed by strings.
+ */
+
+#ifndef STRINGMAP_H_
+#define STRINGMAP_H_
+
+#include <sequence/Config.h>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sequence
+{
+namespace parser
+{
+namespace details
+{
+
+/**
+ * A map from strings to V.
+ *
+ * Entries are stored in insertion order in a deque, which never moves
+ * them, and indexed by a table of slots probed linearly. A slot holds the
+ * hash of its key so lookups only compare the strings whose hashes match,
+ * and growing the table rehashes slots without touching the entries.
+ * Entries can't be erased. Keys hash like boost::hash<std::string>.
+ */
+template<typename V>
+class StringMap
+{
+public:
+	typedef std::string key_type;
+	typedef V mapped_type;
+
+	struct value_type
+	{
+		std::string first;
+		V second;
+	};
+
+	typedef std::deque<value_type> Entries;
+	typedef typename Entries::iterator iterator;
+	typedef typename Entries::const_iterator const_iterator;
+
+	StringMap() :
+		mask( 0 )
+	{
+	}
+
+	iterator begin()
+	{
+		return entries.begin();
+	}
+
+	iterator end()
+	{
+		return entries.end();
+	}
+
+	const_iterator begin() const
+	{
+		return entries.begin();
+	}
+
+	const_iterator end() const
+	{
+		return entries.end();
+	}
+
+	size_t size() const
+	{
+		return entries.size();
+	}
+
+	bool empty() const
+	{
+		return entries.empty();
+	}
+
+	void clear()
+	{
+		entries.clear();
+		std::vector<Slot>().swap( slots );
+		mask = 0;
+	}
+
+	iterator find( const boost::string_ref key )
+	{
+		const size_t slot = lookup( key, hash( key ) );
+		return slot == npos || !slots[slot].index ? entries.end() : entries.begin() + ( slots[slot].index - 1 );
+	}
+
+	const_iterator find( const boost::string_ref key ) const
+	{
+		const size_t slot = lookup( key, hash( key ) );
+		return slot == npos || !slots[slot].index ? entries.end() : entries.begin() + ( slots[slot].index - 1 );
+	}
+
+	/**
+	 * Finds 'key' or appends it with a default constructed value
+	 */
+	std::pair<iterator, bool> insert( const boost::string_ref key )
+	{
+		const size_t hashed = hash( key );
+		size_t slot = lookup( key, hashed );
+		if( slot != npos && slots[slot].index )
+			return std::make_pair( entries.begin() + ( slots[slot].index - 1 ), false );
+		if( 2 * ( entries.size() + 1 ) > slots.size() )
+		{
+			grow( entries.size() + 1 );
+			slot = lookup( key, hashed );
+		}
+		entries.push_back( value_type() );
+		entries.back().first.assign( key.begin(), key.end() );
+		slots[slot].hash = static_cast<boost::uint32_t>( hashed );
+		slots[slot].index = static_cast<boost::uint32_t>( entries.size() );
+		return std::make_pair( entries.end() - 1, true );
+	}
+
+	/**
+	 * Sizes the table so 'count' keys are inserted without rehashing
+	 */
+	void reserve( size_t count )
+	{
+		if( 2 * count > slots.size() )
+			grow( count );
+	}
+
+	/**
+	 * The index of 'itr' in insertion order
+	 */
+	size_t index( const_iterator itr ) const
+	{
+		return itr - entries.begin();
+	}
+
+	const value_type& operator[]( size_t index ) const
+	{
+		return entries[index];
+	}
+
+	static size_t hash( const boost::string_ref key )
+	{
+		return boost::hash_range( key.begin(), key.end() );
+	}
+
+private:
+	static const size_t npos = static_cast<size_t>( -1 );
+
+	struct Slot
+	{
+		boost::uint32_t hash;
+		boost::uint32_t index; ///< index in entries + 1, 0 for an empty slot
+	};
+
+	/**
+	 * The slot holding 'key' or the empty slot where it goes, npos if
+	 * there are no slots yet
+	 */
+	size_t lookup( const boost::string_ref key, size_t hashed ) const
+	{
+		if( slots.empty() )
+			return npos;
+		const boost::uint32_t shortHash = static_cast<boost::uint32_t>( hashed );
+		for( size_t slot = hashed & mask;; slot = ( slot + 1 ) & mask )
+		{
+			const Slot &current = slots[slot];
+			if( !current.index )
+				return slot;
+			if( current.hash == shortHash && entries[current.index - 1].first == key )
+				return slot;
+		}
+	}
+
+	/**
+	 * Rehashes into a power of two table at most half full with 'count' keys
+	 */
+	void grow( size_t count )
+	{
+		size_t capacity = 16;
+		while( capacity < 2 * count )
+			capacity *= 2;
+		std::vector<Slot> grown( capacity );
+		const size_t grownMask = capacity - 1;
+		for( size_t i = 0; i < slots.size(); ++i )
+		{
+			const Slot &current = slots[i];
+			if( !current.index )
+				continue;
+			// the 32 bits kept are enough while the table has less than 2^32 slots
+			size_t slot = current.hash & grownMask;
+			while( grown[slot].index )
+				slot = ( slot + 1 ) & grownMask;
+			grown[slot] = current;
+		}
+		slots.swap( grown );
+		mask = grownMask;
+	}
+
+	Entries entries;
+	std::vector<Slot> slots;
+	size_t mask;
+};
+
+}
+}
+}
+
+#endif
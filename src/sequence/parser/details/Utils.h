@@ -12,12 +12,26 @@
 #include <sequence/Range.h>
 #include <sequence/Sequence.h>
 #include <sequence/BrowseItem.h>
+#include <sequence/parser/Columns.h>
+#include <sequence/parser/Statistics.h>
+#include <sequence/parser/details/StringMap.h>
 #include <boost/bind.hpp>
 #include <boost/unordered_map.hpp>
 #include <boost/container/flat_set.hpp>
+#include <boost/container/vector.hpp>
+#include <boost/move/move.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/ref.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/utility/string_ref.hpp>
+#include <algorithm>
+#include <deque>
 #include <vector>
 #include <numeric>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
 
 #include <iostream>
 
@@ -33,35 +47,41 @@ static inline bool isDigit( std::string::value_type c )
 	return c >= '0' && c <= '9';
 }
 
-static inline size_t atoi( std::string::const_iterator begin, const std::string::const_iterator end )
+static inline boost::uint64_t atoi( std::string::const_iterator begin, const std::string::const_iterator end )
 {
-	size_t value = 0;
+	boost::uint64_t value = 0;
 	for( ; begin != end; ++begin )
 		value = value * 10 + ( *begin - '0');
 	return value;
 }
 
 /**
- * The type used to store values found in the pattern
+ * The default type used to store values found in the pattern
  */
 typedef unsigned int value_type;
 
+/**
+ * Numbers with more digits than this may not fit in 64 bits, they are left
+ * as is in the pattern
+ */
+const size_t gMaxDigits = 19;
+
 /**
  * A set of numbers found in filenames
  */
-typedef std::vector<value_type> Values;
+typedef std::vector<boost::uint64_t> Values;
 
 /**
  * A location within a string
  */
 struct SEQUENCEPARSER_LOCAL Location
 {
-	unsigned char first;
+	unsigned short first;
 	unsigned char count;
 	Location()
 	{}
 
-	Location( unsigned char first, unsigned char count ) :
+	Location( unsigned short first, unsigned char count ) :
 		first( first ),
 		count( count )
 	{}
@@ -80,6 +100,7 @@ typedef std::vector<Location> Locations;
  * will produce the following locations : [5,2],[8,4],[15,1]
  * will produce the following number    : 20,1234,2
  * will produce the following pattern   : file-##.####.cr#
+ * Numbers longer than gMaxDigits are not considered as numbers.
  */
 static void extractPattern( std::string &pattern, Locations &locations, Values &values )
 {
@@ -95,14 +116,29 @@ static void extractPattern( std::string &pattern, Locations &locations, Values &
 		Location location;
 		location.first = distance( begin, current );
 		const Itr pastDigitEnd = find_if( current, end, std::not1( std::ptr_fun( isDigit ) ) );
-		location.count = distance( current, pastDigitEnd );
-		values.push_back( atoi( current, pastDigitEnd ) );
-		locations.push_back( location );
-		fill( current, pastDigitEnd, '#' );
+		const size_t count = distance( current, pastDigitEnd );
+		if( count <= gMaxDigits )
+		{
+			location.count = count;
+			values.push_back( atoi( current, pastDigitEnd ) );
+			locations.push_back( location );
+			fill( current, pastDigitEnd, '#' );
+		}
 		current = pastDigitEnd;
 	}
 }
 
+/**
+ * The greatest number of digits amongst the locations
+ */
+static inline size_t maxDigits( const Locations &locations )
+{
+	size_t digits = 0;
+	for( Locations::const_iterator itr = locations.begin(), end = locations.end(); itr != end; ++itr )
+		digits = std::max( digits, size_t( itr->count ) );
+	return digits;
+}
+
 /**
  * In a sorted container, count the number of different values
  */
@@ -166,21 +202,29 @@ static Ranges getRangesAndStep( ForwardIterator begin, const ForwardIterator end
 	return ranges;
 }
 
-typedef boost::container::flat_set<value_type> Set;
-
-struct LocationData
+template<typename T>
+struct BasicLocationData
 {
-	LocationData( const LocationData &other )
+	typedef T value_type;
+	typedef std::vector<T> Values;
+	typedef boost::container::flat_set<T> Set;
+
+	BasicLocationData( const BasicLocationData &other ) :
+		location    ( other.location ),
+		allValues   ( other.allValues ),
+		sortedValues( other.sortedValues )
 	{
-		allValues    = other.allValues;
-		location     = other.location;
-		sortedValues = other.sortedValues;
 	}
 
-	LocationData()
+	BasicLocationData( BOOST_RV_REF( BasicLocationData ) other ) :
+		location( other.location )
+	{
+		allValues.swap( other.allValues );
+		sortedValues.swap( other.sortedValues );
+	}
+
+	BasicLocationData()
 	{
-		static size_t preAllocate = 64 * 1024;
-		allValues.reserve( preAllocate );
 	}
 
 	inline void insert( value_type value )
@@ -204,7 +248,7 @@ struct LocationData
 		value = *sortedValues.begin();
 		return sortedValues.size() == 1;
 	}
-	LocationData& operator=( const LocationData &other )
+	BasicLocationData& operator=( BOOST_COPY_ASSIGN_REF( BasicLocationData ) other )
 	{
 		if( this != &other )
 		{
@@ -214,20 +258,38 @@ struct LocationData
 		}
 		return *this;
 	}
+	BasicLocationData& operator=( BOOST_RV_REF( BasicLocationData ) other )
+	{
+		if( this != &other )
+		{
+			allValues.swap( other.allValues );
+			location = other.location;
+			sortedValues.swap( other.sortedValues );
+		}
+		return *this;
+	}
 
 	Location location;
 	Values allValues;
 	Set sortedValues;
 
-	static bool less( const LocationData &a, const LocationData &b )
+	static bool less( const BasicLocationData &a, const BasicLocationData &b )
 	{
 		return a.sortedValues.size() < b.sortedValues.size();
 	}
+
+private:
+	BOOST_COPYABLE_AND_MOVABLE( BasicLocationData )
 };
 
-typedef std::vector<LocationData> LocationDatas;
+typedef BasicLocationData<value_type> LocationData;
+
+typedef boost::container::vector<LocationData> LocationDatas;
+
+typedef LocationData::Set Set;
 
-static inline void overwrite( unsigned int value, std::string &inString, const Location &atLocation )
+template<typename T>
+static inline void overwrite( T value, std::string &inString, const Location &atLocation )
 {
 	sequence::details::CharStack<> stack( value );
 
@@ -239,38 +301,103 @@ static inline void overwrite( unsigned int value, std::string &inString, const L
 		*ptr = stack.top();
 }
 
-struct Pattern
+template<typename T>
+struct BasicPattern
 {
-	Pattern( const std::string &key, const Locations& locations ) :
+	typedef T value_type;
+	typedef BasicLocationData<T> LocationData;
+	typedef boost::container::vector<LocationData> LocationDatas;
+	typedef std::vector<T> Values;
+
+	BasicPattern()
+	{
+	}
+
+	BasicPattern( const std::string &key, const Locations& locations ) :
 		key( key ),
 		locationData( locations.size() )
 	{
 		for( size_t i = 0; i < locations.size(); ++i )
 			locationData[i].location = locations[i];
+	}
 
-		allValues.reserve( locations.size() * 8 * 1024 );
+	BasicPattern( const BasicPattern &other ) :
+		key         ( other.key ),
+		allValues   ( other.allValues ),
+		locationData( other.locationData )
+	{
+	}
+
+	BasicPattern( BOOST_RV_REF( BasicPattern ) other )
+	{
+		key.swap( other.key );
+		allValues.swap( other.allValues );
+		locationData.swap( other.locationData );
 	}
 
-	inline void insert( const Values &values )
+	BasicPattern& operator=( BOOST_COPY_ASSIGN_REF( BasicPattern ) other )
+	{
+		if( this != &other )
+		{
+			key          = other.key;
+			allValues    = other.allValues;
+			locationData = other.locationData;
+		}
+		return *this;
+	}
+
+	BasicPattern& operator=( BOOST_RV_REF( BasicPattern ) other )
+	{
+		if( this != &other )
+		{
+			key.swap( other.key );
+			allValues.swap( other.allValues );
+			locationData.swap( other.locationData );
+		}
+		return *this;
+	}
+
+	template<typename Container>
+	inline void insert( const Container &values )
 	{
 		assert( values.size() == locationData.size() );
 		allValues.insert( allValues.end(), values.begin(), values.end() );
 	}
 
+	/**
+	 * True if a single file was inserted
+	 */
+	bool single() const
+	{
+		return allValues.size() == locationData.size();
+	}
+
+	/**
+	 * The filename of a single file, before prepare()
+	 */
+	std::string singleFilename() const
+	{
+		assert( single() );
+		std::string filename = key;
+		for( size_t i = 0; i < locationData.size(); ++i )
+			overwrite( allValues[i], filename, locationData[i].location );
+		return filename;
+	}
+
 	void prepare()
 	{
 		if( locationData.empty() )
 			return;
 
 		const size_t elements = allValues.size() / locationData.size();
-		const LocationDatas::iterator begin = locationData.begin();
-		const LocationDatas::iterator end = locationData.end();
+		const typename LocationDatas::iterator begin = locationData.begin();
+		const typename LocationDatas::iterator end = locationData.end();
 
 		std::for_each( begin, end, boost::bind( &LocationData::reserve, _1, elements ) );
 
-		LocationDatas::iterator itr = begin;
+		typename LocationDatas::iterator itr = begin;
 
-		for( Values::const_iterator vItr = allValues.begin(), vEnd = allValues.end();
+		for( typename Values::const_iterator vItr = allValues.begin(), vEnd = allValues.end();
 			 vItr != vEnd;
 			 ++vItr, ++itr )
 		{
@@ -283,20 +410,52 @@ struct Pattern
 		allValues.clear();
 	}
 
+	/**
+	 * Once prepared, keeps only the files having the greatest value at
+	 * location 'column'
+	 */
+	void keepMaximum( size_t column )
+	{
+		const T maximum = *locationData[column].sortedValues.rbegin();
+		const Values kept = locationData[column].allValues;
+		for( typename LocationDatas::iterator itr = locationData.begin(), end = locationData.end(); itr != end; ++itr )
+		{
+			Values &values = itr->allValues;
+			size_t size = 0;
+			for( size_t i = 0; i < kept.size(); ++i )
+				if( kept[i] == maximum )
+					values[size++] = values[i];
+			values.resize( size );
+			itr->sortedValues.clear();
+			itr->computeDistinctValues();
+		}
+	}
+
+	/**
+	 * An estimation of the memory held by the pattern
+	 */
+	size_t allocatedBytes() const
+	{
+		size_t bytes = sizeof( BasicPattern ) + key.capacity() + allValues.capacity() * sizeof( value_type );
+		for( typename LocationDatas::const_iterator itr = locationData.begin(), end = locationData.end(); itr != end; ++itr )
+			bytes += sizeof( LocationData ) + ( itr->allValues.capacity() + itr->sortedValues.capacity() ) * sizeof( value_type );
+		return bytes;
+	}
+
 	void bakeConstantLocations()
 	{
 		LocationDatas newLocations;
 		newLocations.reserve( locationData.size() );
-		for( LocationDatas::const_iterator itr = locationData.begin(), end = locationData.end();
+		for( typename LocationDatas::iterator itr = locationData.begin(), end = locationData.end();
 			 itr != end;
 			 ++itr )
 		{
-			const LocationData &current = *itr;
+			LocationData &current = *itr;
 			value_type value = 0;
 			if( current.dismiss( value ) )
 				overwrite( value, key, current.location );
 			else
-				newLocations.push_back( current );
+				newLocations.push_back( boost::move( current ) );
 		}
 		locationData.swap( newLocations );
 	}
@@ -304,11 +463,60 @@ struct Pattern
 	std::string key;
 	Values allValues;
 	LocationDatas locationData;
+
+private:
+	BOOST_COPYABLE_AND_MOVABLE( BasicPattern )
 };
 
-typedef boost::unordered::unordered_map<std::string, Pattern> PatternsPerDir;
+typedef BasicPattern<value_type> Pattern;
+
+template<typename T>
+struct BasicPatternsPerDir
+{
+	typedef StringMap<BasicPattern<T> > type;
+};
+
+typedef BasicPatternsPerDir<value_type>::type PatternsPerDir;
+
+/**
+ * The pattern of 'key', created with 'locations' if missing.
+ * Works on node based maps as well, for comparison.
+ */
+template<typename T>
+static std::pair<BasicPattern<T>*, bool> findOrCreate( StringMap<BasicPattern<T> > &map, const std::string &key, const Locations &locations )
+{
+	const std::pair<typename StringMap<BasicPattern<T> >::iterator, bool> inserted = map.insert( key );
+	if( inserted.second )
+	{
+		BasicPattern<T> created( key, locations );
+		inserted.first->second = boost::move( created );
+	}
+	return std::make_pair( &inserted.first->second, inserted.second );
+}
+
+template<typename T>
+static std::pair<BasicPattern<T>*, bool> findOrCreate( boost::unordered_map<std::string, BasicPattern<T> > &map, const std::string &key, const Locations &locations )
+{
+	typename boost::unordered_map<std::string, BasicPattern<T> >::iterator found = map.find( key );
+	if( found != map.end() )
+		return std::make_pair( &found->second, false );
+	found = map.emplace( boost::unordered::piecewise_construct,
+						 boost::make_tuple( key ),
+						 boost::make_tuple( boost::cref( key ), boost::cref( locations ) ) ).first;
+	return std::make_pair( &found->second, true );
+}
 
-typedef boost::unordered::unordered_map<std::string, PatternsPerDir> AllPatterns;
+/**
+ * The patterns of a directory, each one stored with the narrowest type
+ * able to hold its numbers.
+ */
+struct DirectoryPatterns
+{
+	BasicPatternsPerDir<boost::uint16_t>::type narrow;  ///< at most 4 digits
+	BasicPatternsPerDir<boost::uint32_t>::type regular; ///< at most 9 digits
+	BasicPatternsPerDir<boost::uint64_t>::type wide;    ///< at most gMaxDigits digits
+	std::vector<std::string> files; ///< filenames without any number, duplicates allowed
+};
 
 struct TmpData
 {
@@ -317,60 +525,281 @@ struct TmpData
 };
 
 // filling structures
-static void insert( TmpData &tmpData, PatternsPerDir &map, std::string key )
+template<typename Map>
+static void insertExtracted( const TmpData &tmpData, Map &map, const std::string &key, Statistics *statistics )
 {
-	extractPattern( key, tmpData.locations, tmpData.values );
-	PatternsPerDir::iterator keyItr = map.find( key );
-	if( keyItr == map.end() )
-		keyItr = map.insert( make_pair(key, Pattern( key, tmpData.locations ) ) ).first;
-	keyItr->second.insert( tmpData.values );
+	ScopedTimer timer( statistics, &Statistics::lookupTime );
+	const std::pair<typename Map::mapped_type*, bool> found = findOrCreate( map, key, tmpData.locations );
+	if( found.second && statistics )
+		++statistics->patterns;
+	found.first->insert( tmpData.values );
 }
 
 // filling structures
-static void insertPath( TmpData &tmpData, AllPatterns &allPatterns, const std::string& absolutePath )
+template<typename Map>
+static void insert( TmpData &tmpData, Map &map, std::string key, Statistics *statistics = NULL )
 {
-	const size_t lastSeparator = absolutePath.find_last_of("/\\");
-	const bool emptyParent = lastSeparator == std::string::npos;
-	static const std::string EMPTY;
-	const std::string parent = emptyParent ? EMPTY : absolutePath.substr(0, lastSeparator);
-	AllPatterns::iterator found = allPatterns.find(parent);
+	{
+		ScopedTimer timer( statistics, &Statistics::extractTime );
+		extractPattern( key, tmpData.locations, tmpData.values );
+	}
+	insertExtracted( tmpData, map, key, statistics );
+}
 
-	if( found == allPatterns.end() )
-		found = allPatterns.insert( make_pair( parent, PatternsPerDir() ) ).first;
+// filling structures, dispatching on the number of digits
+static void insert( TmpData &tmpData, DirectoryPatterns &patterns, std::string key, Statistics *statistics = NULL )
+{
+	{
+		ScopedTimer timer( statistics, &Statistics::extractTime );
+		extractPattern( key, tmpData.locations, tmpData.values );
+	}
+	if( tmpData.locations.empty() )
+	{
+		// can't be part of a sequence, no pattern needed
+		patterns.files.push_back( boost::move( key ) );
+		return;
+	}
+	const size_t digits = maxDigits( tmpData.locations );
+	if( digits <= 4 )
+		insertExtracted( tmpData, patterns.narrow, key, statistics );
+	else if( digits <= 9 )
+		insertExtracted( tmpData, patterns.regular, key, statistics );
+	else
+		insertExtracted( tmpData, patterns.wide, key, statistics );
+}
+
+/**
+ * Interned directory paths, a directory being identified by its index.
+ * A directory is stored once whatever the number of files it holds.
+ */
+class PathTable
+{
+public:
+	boost::uint32_t intern( const boost::string_ref path )
+	{
+		return static_cast<boost::uint32_t>( paths.index( paths.insert( path ).first ) );
+	}
+
+	const std::string& path( const boost::uint32_t id ) const
+	{
+		return paths[id].first;
+	}
+
+	size_t size() const
+	{
+		return paths.size();
+	}
+
+	void clear()
+	{
+		paths.clear();
+	}
+
+private:
+	StringMap<bool> paths; ///< values are unused
+};
 
-	const std::string filename = emptyParent ? absolutePath.c_str() : absolutePath.c_str() + lastSeparator + 1;
-	insert( tmpData, found->second, filename );
+/**
+ * The patterns of every directory, indexed by directory id
+ */
+struct AllPatterns
+{
+	PathTable directories;
+	std::deque<DirectoryPatterns> patterns;
+
+	DirectoryPatterns& operator[]( const boost::string_ref directory )
+	{
+		const boost::uint32_t id = directories.intern( directory );
+		if( id == patterns.size() )
+			patterns.push_back( DirectoryPatterns() );
+		return patterns[id];
+	}
+
+	size_t size() const
+	{
+		return patterns.size();
+	}
+
+	void clear()
+	{
+		directories.clear();
+		patterns.clear();
+	}
+};
+
+// the parent directory is looked up without building a string
+static void splitPath( const boost::string_ref absolutePath, boost::string_ref &parent, boost::string_ref &filename )
+{
+	const size_t lastSeparator = absolutePath.find_last_of("/\\");
+	const bool emptyParent = lastSeparator == boost::string_ref::npos;
+	parent = emptyParent ? boost::string_ref() : absolutePath.substr(0, lastSeparator);
+	filename = emptyParent ? absolutePath : absolutePath.substr( lastSeparator + 1 );
+}
+
+static void insertPath( TmpData &tmpData, AllPatterns &allPatterns, const boost::string_ref absolutePath, Statistics *statistics = NULL )
+{
+	if( statistics )
+		++statistics->entries;
+	boost::string_ref parent, filename;
+	splitPath( absolutePath, parent, filename );
+	insert( tmpData, allPatterns[parent], filename.to_string(), statistics );
 }
 
-struct Splitter
+/**
+ * Receives the results of Parser as BrowseItems
+ */
+class ItemsOutput
 {
-	template<typename Pair>
-	struct second_t
+public:
+	ItemsOutput( std::vector<BrowseItem> &items ) :
+		items( items )
+	{
+	}
+
+	void setDirectory( const std::string &path )
+	{
+		directory = path;
+	}
+
+	void addFile( const std::string &filename )
 	{
-		typename Pair::second_type operator()( const Pair& p ) const
+		newItem( UNITFILE ).path /= filename;
+	}
+
+	/**
+	 * 'pattern' is taken over if it is the 'last' use
+	 */
+	void addSequence( SequencePattern &pattern, const Range &range, unsigned short step, bool last )
+	{
+		Sequence &sequence = newItem( SEQUENCE ).sequence;
+		if( last )
 		{
-			return p.second;
+			sequence.pattern.prefix.swap( pattern.prefix );
+			sequence.pattern.suffix.swap( pattern.suffix );
+			sequence.pattern.padding = pattern.padding;
 		}
-	};
+		else
+			sequence.pattern = pattern;
+		sequence.range = range;
+		sequence.step = step;
+	}
 
-	template<typename Map>
-	second_t<typename Map::value_type> second(const Map& m)
+private:
+	BrowseItem& newItem( const BrowseItemType type )
 	{
-		return second_t<typename Map::value_type>();
+		items.push_back( BrowseItem() );
+		BrowseItem &item = items.back();
+		item.type = type;
+		item.path = directory;
+		return item;
 	}
 
-	Splitter(const Pattern& pattern) :
+	std::vector<BrowseItem> &items;
+	boost::filesystem::path directory;
+};
+
+/**
+ * Receives the results of Parser as Columns, the directory of an item
+ * being an index instead of a copy
+ */
+class ColumnsOutput
+{
+public:
+	ColumnsOutput( Columns &columns ) :
+		builder( columns ),
+		directory( 0 )
+	{
+	}
+
+	void setDirectory( const std::string &path )
+	{
+		directory = builder.intern( path );
+	}
+
+	void addFile( const std::string &filename )
+	{
+		builder.addFile( UNITFILE, directory, builder.intern( filename ) );
+	}
+
+	void addSequence( SequencePattern &pattern, const Range &range, unsigned short step, bool )
+	{
+		builder.addSequence( directory, pattern, range, step );
+	}
+
+private:
+	ColumnsBuilder builder;
+	boost::uint32_t directory;
+};
+
+template<typename T>
+struct BasicSplitter
+{
+	typedef BasicPattern<T> Pattern;
+	typedef typename Pattern::LocationData LocationData;
+	typedef typename Pattern::LocationDatas LocationDatas;
+	typedef typename Pattern::Values Values;
+	typedef boost::container::vector<Pattern> Patterns;
+
+	BasicSplitter(const Pattern& pattern) :
 		pattern  ( pattern ),
 		locations( pattern.locationData ),
 		begin    ( locations.begin() ),
 		end      ( locations.end() ),
 		pivot    ( std::min_element( begin, end, &LocationData::less ) )
+	{
+		split();
+	}
+
+	/**
+	 * Splits on the values of the location at 'pivotIndex'
+	 */
+	BasicSplitter( const Pattern& pattern, size_t pivotIndex ) :
+		pattern  ( pattern ),
+		locations( pattern.locationData ),
+		begin    ( locations.begin() ),
+		end      ( locations.end() ),
+		pivot    ( begin + pivotIndex )
+	{
+		split();
+	}
+
+	/**
+	 * The location to split on first, neither 'excluded' nor the rightmost
+	 * one, which holds the frame number unless it is 'excluded'. Fewer
+	 * values give fewer patterns to split again; on ties the widest span is
+	 * chosen as sparse numbers are rather identifiers than counters.
+	 */
+	static size_t framePivot( const LocationDatas &locations, size_t excluded )
+	{
+		const size_t frame = locations.size() - 1 == excluded ? locations.size() : locations.size() - 1;
+		size_t pivot = locations.size();
+		for( size_t i = 0; i < locations.size(); ++i )
+		{
+			if( i == excluded || i == frame )
+				continue;
+			if( pivot == locations.size() || cheaper( locations[i], locations[pivot] ) )
+				pivot = i;
+		}
+		assert( pivot != locations.size() );
+		return pivot;
+	}
+
+	static bool cheaper( const LocationData &a, const LocationData &b )
+	{
+		const size_t aCount = a.sortedValues.size();
+		const size_t bCount = b.sortedValues.size();
+		if( aCount != bCount )
+			return aCount < bCount;
+		return *a.sortedValues.rbegin() - *a.sortedValues.begin() > *b.sortedValues.rbegin() - *b.sortedValues.begin();
+	}
+
+	void split()
 	{
 		assert(locations.size()>1);
 
 		// getting pointers to all other columns
 		pColumns.reserve( locations.size() );
-		for( LocationDatas::const_iterator itr = begin; itr != end; ++itr )
+		for( typename LocationDatas::const_iterator itr = begin; itr != end; ++itr )
 		{
 			if( itr != pivot )
 				pColumns.push_back(itr);
@@ -379,66 +808,345 @@ struct Splitter
 		const Values &dispatcher = pivot->allValues;
 		size_t i = 0;
 		Values tmp;
-		for( Values::const_iterator pValue = dispatcher.begin(), pValueEnd = dispatcher.end();
+		for( typename Values::const_iterator pValue = dispatcher.begin(), pValueEnd = dispatcher.end();
 			 pValue != pValueEnd;
 			 ++pValue, ++i)
 		{
 			tmp.clear();
-			for( LocationsPtr::const_iterator itr = pColumns.begin(), end = pColumns.end(); itr != end; ++itr )
+			for( typename LocationsPtr::const_iterator itr = pColumns.begin(), end = pColumns.end(); itr != end; ++itr )
 				tmp.push_back( ( *itr )->allValues[i] );
 
 			getPattern( *pValue ).insert( tmp );
 		}
-		std::transform( map.begin(), map.end(), std::back_inserter( patterns ), second_t<Map::value_type>() );
 	}
 
-	Pattern& getPattern( value_type value )
+	Pattern& getPattern( T value )
 	{
-		Map::iterator pFound = map.find( value );
+		typename Map::iterator pFound = map.find( value );
 		if( pFound == map.end() )
 		{
 			std::string key = pattern.key;
 			overwrite( value, key, pivot->location );
 			Locations newLocations;
 
-			for( LocationsPtr::const_iterator itr = pColumns.begin(), end = pColumns.end();
+			for( typename LocationsPtr::const_iterator itr = pColumns.begin(), end = pColumns.end();
 				 itr != end;
 				 ++itr )
 				newLocations.push_back( ( *itr )->location );
 
-			Pattern newPattern( key, newLocations );
-			pFound = map.insert( std::make_pair( value, newPattern ) ).first;
+			pFound = map.insert( std::make_pair( value, patterns.size() ) ).first;
+			patterns.emplace_back( key, newLocations );
 		}
-		return pFound->second;
+		return patterns[pFound->second];
 	}
 
-	typedef LocationDatas::const_iterator LocationPtr;
+	typedef typename LocationDatas::const_iterator LocationPtr;
 	typedef std::vector<LocationPtr> LocationsPtr;
-	typedef std::map<size_t, Pattern> Map;
+	typedef std::map<T, size_t> Map; ///< value to index in patterns
 
 	const Pattern        &pattern;
 	const LocationDatas  &locations;
 	const LocationPtr    begin, end, pivot;
 	LocationsPtr         pColumns;
 	Map                  map;
-	std::vector<Pattern> patterns;
+	Patterns             patterns;
 };
 
+typedef BasicSplitter<value_type> Splitter;
+
+// merging and serializing the state of a Parser before its results are computed
+const char gStateMagic[8] = { 'S', 'E', 'Q', 'S', 'T', 'A', 'T', 'E' };
+const boost::uint32_t gStateVersion = 2;
+
+template<typename Map>
+static void mergePatterns( Map &into, Map &from )
+{
+	typedef typename Map::mapped_type Pattern;
+	for( typename Map::iterator itr = from.begin(), end = from.end(); itr != end; ++itr )
+	{
+		const std::pair<Pattern*, bool> inserted = findOrCreate( into, itr->first, Locations() );
+		Pattern &pattern = *inserted.first;
+		if( inserted.second )
+			pattern = boost::move( itr->second );
+		else
+			pattern.allValues.insert( pattern.allValues.end(), itr->second.allValues.begin(), itr->second.allValues.end() );
+	}
+	from.clear();
+}
+
+template<typename T>
+static inline void writeRaw( std::ostream &stream, const T &value )
+{
+	stream.write( reinterpret_cast<const char*>( &value ), sizeof( T ) );
+}
+
+template<typename T>
+static inline void readRaw( std::istream &stream, T &value )
+{
+	if( !stream.read( reinterpret_cast<char*>( &value ), sizeof( T ) ) )
+		throw std::runtime_error( "Truncated parser state" );
+}
+
+static inline void writeString( std::ostream &stream, const std::string &value )
+{
+	writeRaw( stream, boost::uint32_t( value.size() ) );
+	stream.write( value.data(), value.size() );
+}
+
+/**
+ * Elements read at once : a corrupted size fails on the end of the stream
+ * instead of allocating what it claims
+ */
+const size_t gStateChunk = 1 << 16;
+
+/**
+ * Appends 'size' elements read from 'stream' to 'values'
+ */
+template<typename Container>
+static void readArray( std::istream &stream, Container &values, boost::uint64_t size )
+{
+	while( size )
+	{
+		const size_t chunk = static_cast<size_t>( std::min<boost::uint64_t>( size, gStateChunk ) );
+		const size_t previous = values.size();
+		values.resize( previous + chunk );
+		if( !stream.read( reinterpret_cast<char*>( &values[previous] ), chunk * sizeof( values[0] ) ) )
+			throw std::runtime_error( "Truncated parser state" );
+		size -= chunk;
+	}
+}
+
+static inline void readString( std::istream &stream, std::string &value )
+{
+	boost::uint32_t size;
+	readRaw( stream, size );
+	value.clear();
+	readArray( stream, value, size );
+}
+
+template<typename Map>
+static void savePatterns( std::ostream &stream, const Map &patterns )
+{
+	writeRaw( stream, boost::uint64_t( patterns.size() ) );
+	for( typename Map::const_iterator itr = patterns.begin(), end = patterns.end(); itr != end; ++itr )
+	{
+		const typename Map::mapped_type &pattern = itr->second;
+		writeString( stream, pattern.key );
+		writeRaw( stream, boost::uint8_t( pattern.locationData.size() ) );
+		for( size_t i = 0; i < pattern.locationData.size(); ++i )
+		{
+			writeRaw( stream, pattern.locationData[i].location.first );
+			writeRaw( stream, pattern.locationData[i].location.count );
+		}
+		writeRaw( stream, boost::uint64_t( pattern.allValues.size() ) );
+		if( !pattern.allValues.empty() )
+			stream.write( reinterpret_cast<const char*>( &pattern.allValues[0] ), pattern.allValues.size() * sizeof( pattern.allValues[0] ) );
+	}
+}
+
+template<typename Map>
+static void loadPatterns( std::istream &stream, Map &patterns )
+{
+	typedef typename Map::mapped_type Pattern;
+	boost::uint64_t count;
+	readRaw( stream, count );
+	std::string key;
+	Locations locations;
+	for( ; count; --count )
+	{
+		readString( stream, key );
+		boost::uint8_t locationCount;
+		readRaw( stream, locationCount );
+		locations.resize( locationCount );
+		for( size_t i = 0; i < locations.size(); ++i )
+		{
+			readRaw( stream, locations[i].first );
+			readRaw( stream, locations[i].count );
+		}
+		boost::uint64_t size;
+		readRaw( stream, size );
+		if( locations.empty() ? size != 0 : size % locations.size() != 0 )
+			throw std::runtime_error( "Invalid parser state" );
+		const std::pair<Pattern*, bool> inserted = findOrCreate( patterns, key, locations );
+		typename Pattern::Values &values = inserted.first->allValues;
+		if( inserted.first->locationData.size() != locations.size() )
+			throw std::runtime_error( "Invalid parser state" );
+		// read in place, after the values already there
+		readArray( stream, values, size );
+	}
+}
+
 struct Parser
 {
-	inline void insert( const std::string& absolutePath )
+	Parser() :
+		statistics( NULL ),
+		splitStrategy( SPLIT_FRAME_LAST )
+	{}
+
+	/**
+	 * Counters and timings will be added to 'statistics', NULL disables them
+	 */
+	void setStatistics( Statistics *statistics )
+	{
+		this->statistics = statistics;
+	}
+
+	/**
+	 * When not empty, the number right after 'prefix' in a filename is a
+	 * version : of each sequence only the files of its greatest version
+	 * are reported. The sequence is told by the numbers other than the
+	 * version and the rightmost one, taken as the frame number.
+	 */
+	void setVersionPrefix( const std::string &prefix )
 	{
-		insertPath( tmp, allPatterns, absolutePath );
+		versionPrefix = prefix;
 	}
 
-	std::vector<sequence::BrowseItem> getResults()
+	void setSplitStrategy( SplitStrategy strategy )
+	{
+		splitStrategy = strategy;
+	}
+
+	/**
+	 * Sizes the tables of the directory holding 'absolutePath' for about
+	 * 'entries' files, sparing the rehashes of a huge directory. Only the
+	 * patterns of numbers of at most 4 digits, the usual ones, are presized :
+	 * reserving the wider ones as well would mostly waste memory.
+	 */
+	void reserveDirectoryOf( const boost::string_ref absolutePath, size_t entries )
+	{
+		boost::string_ref parent, filename;
+		splitPath( absolutePath, parent, filename );
+		allPatterns[parent].narrow.reserve( entries );
+	}
+
+	inline void insert( const boost::string_ref absolutePath )
+	{
+		insertPath( tmp, allPatterns, absolutePath, statistics );
+	}
+
+	/**
+	 * The items found, computed on the first call
+	 */
+	const std::vector<sequence::BrowseItem>& getResults()
 	{
 		if( !results.empty() )
 			return results;
-		std::for_each( allPatterns.begin(), allPatterns.end(), boost::bind( &Parser::preparePath, this, _1 ) );
+		ItemsOutput output( results );
+		prepare( output );
+		if( statistics )
+			statistics->results += results.size();
 		return results;
 	}
 
+	/**
+	 * Hands the items found over to 'items' without copying them.
+	 * The parser is left empty and can be filled again.
+	 */
+	void releaseResults( std::vector<sequence::BrowseItem> &items )
+	{
+		getResults();
+		items.swap( results );
+		results.clear();
+		allPatterns.clear();
+	}
+
+	/**
+	 * Appends the items found to 'columns', each directory being stored
+	 * once. The parser is left empty and can be filled again.
+	 */
+	void releaseColumns( Columns &columns )
+	{
+		if( !results.empty() )
+			throw std::logic_error( "Results were already computed as items" );
+		const size_t before = columns.size();
+		ColumnsOutput output( columns );
+		prepare( output );
+		if( statistics )
+			statistics->results += columns.size() - before;
+		allPatterns.clear();
+	}
+
+	/**
+	 * Adds the paths inserted in 'other' to this parser, 'other' is left empty.
+	 * Inserting paths in several parsers then merging them gives the same
+	 * results as inserting them all in a single one.
+	 * Neither parser must have computed its results.
+	 */
+	void merge( Parser &other )
+	{
+		if( !results.empty() || !other.results.empty() )
+			throw std::logic_error( "Can't merge a parser once its results are computed" );
+		for( boost::uint32_t id = 0; id < other.allPatterns.size(); ++id )
+		{
+			DirectoryPatterns &patterns = allPatterns[other.allPatterns.directories.path( id )];
+			DirectoryPatterns &from = other.allPatterns.patterns[id];
+			mergePatterns( patterns.narrow, from.narrow );
+			mergePatterns( patterns.regular, from.regular );
+			mergePatterns( patterns.wide, from.wide );
+			patterns.files.insert( patterns.files.end(), from.files.begin(), from.files.end() );
+		}
+		other.allPatterns.clear();
+	}
+
+	/**
+	 * Writes the paths inserted so far in a compact binary form, meant to be
+	 * loaded by a process of the same build on the same machine.
+	 */
+	void save( std::ostream &stream ) const
+	{
+		if( !results.empty() )
+			throw std::logic_error( "Can't save a parser once its results are computed" );
+		stream.write( gStateMagic, sizeof( gStateMagic ) );
+		writeRaw( stream, gStateVersion );
+		writeRaw( stream, boost::uint64_t( allPatterns.size() ) );
+		for( boost::uint32_t id = 0; id < allPatterns.size(); ++id )
+		{
+			const DirectoryPatterns &patterns = allPatterns.patterns[id];
+			writeString( stream, allPatterns.directories.path( id ) );
+			savePatterns( stream, patterns.narrow );
+			savePatterns( stream, patterns.regular );
+			savePatterns( stream, patterns.wide );
+			writeRaw( stream, boost::uint64_t( patterns.files.size() ) );
+			for( std::vector<std::string>::const_iterator itr = patterns.files.begin(); itr != patterns.files.end(); ++itr )
+				writeString( stream, *itr );
+		}
+	}
+
+	/**
+	 * Merges a state written by save() into this parser
+	 */
+	void load( std::istream &stream )
+	{
+		if( !results.empty() )
+			throw std::logic_error( "Can't load in a parser once its results are computed" );
+		char magic[sizeof( gStateMagic )];
+		boost::uint32_t version;
+		if( !stream.read( magic, sizeof( magic ) ) || !std::equal( magic, magic + sizeof( magic ), gStateMagic ) )
+			throw std::runtime_error( "Not a parser state" );
+		readRaw( stream, version );
+		if( version != gStateVersion )
+			throw std::runtime_error( "Unsupported parser state version" );
+		boost::uint64_t directories;
+		readRaw( stream, directories );
+		std::string directory;
+		for( ; directories; --directories )
+		{
+			readString( stream, directory );
+			DirectoryPatterns &patterns = allPatterns[directory];
+			loadPatterns( stream, patterns.narrow );
+			loadPatterns( stream, patterns.regular );
+			loadPatterns( stream, patterns.wide );
+			boost::uint64_t files;
+			readRaw( stream, files );
+			for( ; files; --files )
+			{
+				patterns.files.push_back( std::string() );
+				readString( stream, patterns.files.back() );
+			}
+		}
+	}
+
 	struct Functor
 	{
 		Functor( Parser *pParser ) :
@@ -459,56 +1167,154 @@ struct Parser
 
 private:
 
-	void addPattern(const std::string& path, const Pattern& pattern)
+	template<typename Output, typename T>
+	void addPattern( Output &output, const BasicPattern<T>& pattern )
 	{
-		const LocationDatas &locations = pattern.locationData;
+		ScopedTimer timer( statistics, &Statistics::resultsTime );
+		const typename BasicPattern<T>::LocationDatas &locations = pattern.locationData;
 		if( locations.empty() )
 		{
-			results.push_back( create_file( boost::filesystem::path( path ) / pattern.key ) );
+			output.addFile( pattern.key );
 			return;
 		}
 		assert( locations.size() == 1 );
-		const LocationData &location = locations[0];
-		const Set &set = location.sortedValues;
+		const typename BasicPattern<T>::LocationData &location = locations[0];
+		const typename BasicLocationData<T>::Set &set = location.sortedValues;
+		if( *set.rbegin() > std::numeric_limits<unsigned int>::max() )
+		{
+			// a Range can't hold such numbers, files are reported one by one
+			for( typename BasicLocationData<T>::Set::const_iterator itr = set.begin(), end = set.end(); itr != end; ++itr )
+			{
+				std::string filename = pattern.key;
+				overwrite( *itr, filename, location.location );
+				output.addFile( filename );
+			}
+			return;
+		}
 		size_t step = 0;
 		const Ranges ranges = getRangesAndStep(set.begin(), set.end(), step);
 
-		std::transform( ranges.begin(),
-						ranges.end(),
-						std::back_inserter( results ),
-						boost::bind( &Parser::createItem, this, boost::ref( path ), boost::ref( pattern ), _1, step ) );
+		// parsed once for all the ranges, the last one takes it over
+		SequencePattern sequencePattern = parsePattern( pattern.key );
+		for( Ranges::const_iterator itr = ranges.begin(), end = ranges.end(); itr != end; ++itr )
+			output.addSequence( sequencePattern, *itr, step, itr + 1 == end );
 	}
 
-	BrowseItem createItem( const std::string &path, const Pattern& pattern, const Range range, const size_t step )
+	template<typename Output>
+	void prepare( Output &output )
 	{
-		return create_sequence( path, parsePattern( pattern.key ), range, step );
+		for( boost::uint32_t id = 0; id < allPatterns.size(); ++id )
+		{
+			output.setDirectory( allPatterns.directories.path( id ) );
+			DirectoryPatterns &patterns = allPatterns.patterns[id];
+			preparePatterns( output, patterns.narrow );
+			preparePatterns( output, patterns.regular );
+			preparePatterns( output, patterns.wide );
+			addFiles( output, patterns.files );
+		}
 	}
-	void preparePath( AllPatterns::value_type &pair )
+
+	template<typename Output>
+	void addFiles( Output &output, std::vector<std::string> &files )
 	{
-		std::vector<Pattern> ready;
-		PatternsPerDir &patterns = pair.second;
-		std::for_each( patterns.begin(), patterns.end(), boost::bind( &Parser::preparePattern, boost::ref( ready ), _1 ) );
-		const std::string &path = pair.first;
-		std::for_each( ready.begin(), ready.end(), boost::bind( &Parser::addPattern, this, boost::ref( path ), _1 ) );
+		ScopedTimer timer( statistics, &Statistics::resultsTime );
+		std::sort( files.begin(), files.end() );
+		files.erase( std::unique( files.begin(), files.end() ), files.end() );
+		for( std::vector<std::string>::const_iterator itr = files.begin(); itr != files.end(); ++itr )
+			output.addFile( *itr );
 	}
-	static void preparePattern( std::vector<Pattern> &ready, PatternsPerDir::value_type &pair )
+
+	template<typename Output, typename Map>
+	void preparePatterns( Output &output, Map &patterns )
 	{
-		mutate( ready, pair.second );
+		for( typename Map::iterator itr = patterns.begin(), end = patterns.end(); itr != end; ++itr )
+			mutate( output, itr->second );
 	}
-	static void mutate( std::vector<Pattern>& ready, Pattern& pattern )
+	/**
+	 * Splits the pattern until it has a single varying location, results
+	 * are created as soon as a pattern is ready so patterns are never copied
+	 */
+	template<typename Output, typename T>
+	void mutate( Output &output, BasicPattern<T>& pattern )
 	{
-		pattern.prepare();
-		pattern.bakeConstantLocations();
+		if( pattern.single() )
+		{
+			// nothing to group, typical of photo dumps and hashed names
+			ScopedTimer timer( statistics, &Statistics::resultsTime );
+			output.addFile( pattern.singleFilename() );
+			return;
+		}
+		{
+			ScopedTimer timer( statistics, &Statistics::prepareTime );
+			pattern.prepare();
+			if( statistics )
+				statistics->bytesAllocated += pattern.allocatedBytes();
+			pattern.bakeConstantLocations();
+		}
+		size_t version = versionColumn( pattern );
+		if( version != npos && ( pattern.locationData.size() == 1 || ( pattern.locationData.size() == 2 && version == 0 ) ) )
+		{
+			// nothing or only the frame number is left beside the version, other
+			// numbers being split first so each of their values keeps its latest version
+			ScopedTimer timer( statistics, &Statistics::prepareTime );
+			pattern.keepMaximum( version );
+			pattern.bakeConstantLocations();
+			version = npos;
+		}
 		if( pattern.locationData.size() < 2 )
 		{
-			ready.push_back( pattern );
+			addPattern( output, pattern );
 		}
 		else
 		{
-			Splitter splitter( pattern );
-			std::for_each( splitter.patterns.begin(), splitter.patterns.end(), boost::bind( &Parser::mutate, boost::ref( ready ), _1 ) );
+			typename BasicSplitter<T>::Patterns patterns;
+			{
+				ScopedTimer timer( statistics, &Statistics::splitTime );
+				// the version and the frame number stay together until the version is resolved
+				if( version == npos && splitStrategy == SPLIT_FEWEST_VALUES )
+				{
+					BasicSplitter<T> splitter( pattern );
+					patterns.swap( splitter.patterns );
+				}
+				else
+				{
+					BasicSplitter<T> splitter( pattern, BasicSplitter<T>::framePivot( pattern.locationData, version ) );
+					patterns.swap( splitter.patterns );
+				}
+			}
+			if( statistics )
+			{
+				++statistics->splits;
+				statistics->patterns += patterns.size();
+			}
+			for( typename BasicSplitter<T>::Patterns::iterator itr = patterns.begin(), end = patterns.end(); itr != end; ++itr )
+				mutate( output, *itr );
 		}
 	}
+
+	static const size_t npos = static_cast<size_t>( -1 );
+
+	/**
+	 * The varying location holding the version, npos if none
+	 */
+	template<typename T>
+	size_t versionColumn( const BasicPattern<T>& pattern ) const
+	{
+		if( versionPrefix.empty() )
+			return npos;
+		const size_t size = versionPrefix.size();
+		for( size_t i = 0; i < pattern.locationData.size(); ++i )
+		{
+			const Location &location = pattern.locationData[i].location;
+			if( location.first >= size && pattern.key.compare( location.first - size, size, versionPrefix ) == 0 )
+				return i;
+		}
+		return npos;
+	}
+
+	Statistics *statistics;
+	SplitStrategy splitStrategy;
+	std::string versionPrefix;
 	TmpData tmp;
 	AllPatterns allPatterns;
 	std::vector<sequence::BrowseItem> results;
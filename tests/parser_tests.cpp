@@ -1,13 +1,28 @@
+#include <sequence/parser/BrowseCache.h>
 #include <sequence/parser/Browser.h>
+#include <sequence/parser/Columns.h>
+#include <sequence/parser/Daemon.h>
+#include <sequence/parser/FlatItems.h>
+#include <sequence/parser/Metadata.h>
+#include <sequence/parser/NaturalSort.h>
+#include <sequence/parser/PathList.h>
+#include <sequence/parser/SequenceIndex.h>
+#include <sequence/parser/Statistics.h>
+#include <sequence/parser/Walker.h>
 #include <sequence/parser/details/Utils.h>
 #include <sequence/DisplayUtils.h>
 
-#include <boost/filesystem/path.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
 #include <boost/assign/std/set.hpp>
 #include <boost/assign/list_of.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #include <sstream>
 #include <ostream>
+#include <string>
+#include <cstring>
 
 #define BOOST_TEST_MODULE Parser
 #include <boost/test/unit_test.hpp>
@@ -28,6 +43,11 @@ static inline void check_equals( const Range &a, const Range &b )
 	BOOST_CHECK_EQUAL( a.last, b.last );
 }
 
+static bool pathLess( const BrowseItem &a, const BrowseItem &b )
+{
+	return a.path.string() + a.sequence.pattern.string() < b.path.string() + b.sequence.pattern.string();
+}
+
 BOOST_AUTO_TEST_SUITE( ParsingSuite )
 
 BOOST_AUTO_TEST_CASE( LocationValueSetGetStepTest )
@@ -259,4 +279,912 @@ BOOST_AUTO_TEST_CASE( TrickyTestCaseWithSeveralIncrementingCounter )
 	}
 }
 
+BOOST_AUTO_TEST_CASE( LongNumbersTest )
+{
+	{
+		string key( "a12345678901234567890b20231017123045" );
+		Locations locations;
+		Values values;
+		extractPattern( key, locations, values );
+		// the 20 digits number can't be held by 64 bits and is kept as is
+		BOOST_CHECK_EQUAL( key, "a12345678901234567890b##############" );
+		BOOST_CHECK_EQUAL( locations.size(), 1u );
+		check_equals( locations[0], Location( 22, 14 ) );
+		BOOST_CHECK_EQUAL( values.size(), 1u );
+		BOOST_CHECK_EQUAL( values[0], 20231017123045ULL );
+	}
+	Parser parser;
+	parser.insert( "logs/20231017123045.log" );
+	parser.insert( "logs/20231017123046.log" );
+	parser.insert( "logs/f0000000001.txt" );
+	parser.insert( "logs/f0000000002.txt" );
+	parser.insert( "logs/h0123456789012345678901234.bin" );
+	parser.insert( "logs/h0123456789012345678901235.bin" );
+	parser.insert( "logs/s0001.exr" );
+	parser.insert( "logs/s0002.exr" );
+	std::vector<BrowseItem> items = parser.getResults();
+	sort( items.begin(), items.end(), &less );
+	BOOST_CHECK_EQUAL( items.size(), 6u );
+	{
+		const BrowseItem &item = items[0];
+		BOOST_CHECK_EQUAL( item.type, SEQUENCE );
+		BOOST_CHECK_EQUAL( item.sequence.pattern.prefix, "f" );
+		BOOST_CHECK_EQUAL( item.sequence.pattern.padding, 10u );
+		check_equals( item.sequence.range, Range( 1, 2 ) );
+	}
+	{
+		const BrowseItem &item = items[1];
+		BOOST_CHECK_EQUAL( item.type, SEQUENCE );
+		BOOST_CHECK_EQUAL( item.sequence.pattern.prefix, "s" );
+		BOOST_CHECK_EQUAL( item.sequence.pattern.padding, 4u );
+		check_equals( item.sequence.range, Range( 1, 2 ) );
+	}
+	// too big for a Range, reported as files with their name untouched
+	BOOST_CHECK_EQUAL( items[2].type, UNITFILE );
+	BOOST_CHECK_EQUAL( items[2].path, "logs/20231017123045.log" );
+	BOOST_CHECK_EQUAL( items[3].type, UNITFILE );
+	BOOST_CHECK_EQUAL( items[3].path, "logs/20231017123046.log" );
+	BOOST_CHECK_EQUAL( items[4].type, UNITFILE );
+	BOOST_CHECK_EQUAL( items[4].path, "logs/h0123456789012345678901234.bin" );
+	BOOST_CHECK_EQUAL( items[5].type, UNITFILE );
+	BOOST_CHECK_EQUAL( items[5].path, "logs/h0123456789012345678901235.bin" );
+}
+
+BOOST_AUTO_TEST_CASE( StatisticsTest )
+{
+	parser::Statistics statistics;
+	Parser parser;
+	parser.setStatistics( &statistics );
+	parser.insert( "path/afile.txt" );
+	parser.insert( "path/_1_1_" );
+	parser.insert( "path/_1_2_" );
+	parser.insert( "path/_2_2_" );
+	parser.insert( "path/_2_1_" );
+	BOOST_CHECK_EQUAL( parser.getResults().size(), 3u );
+	BOOST_CHECK_EQUAL( statistics.entries, 5u );
+	BOOST_CHECK_EQUAL( statistics.splits, 1u );
+	BOOST_CHECK_EQUAL( statistics.patterns, 1u + 2u ); // 1 inserted, 2 created by the split, afile.txt needs none
+	BOOST_CHECK_EQUAL( statistics.results, 3u );
+	BOOST_CHECK( statistics.bytesAllocated > 0 );
+}
+
+BOOST_AUTO_TEST_CASE( StringMapTest )
+{
+	StringMap<int> map;
+	BOOST_CHECK( map.find( "a" ) == map.end() );
+	for( int i = 0; i < 1000; ++i )
+	{
+		const std::pair<StringMap<int>::iterator, bool> inserted = map.insert( "key" + boost::lexical_cast<string>( i ) );
+		BOOST_CHECK( inserted.second );
+		inserted.first->second = i;
+	}
+	BOOST_CHECK( !map.insert( "key12" ).second );
+	BOOST_REQUIRE_EQUAL( map.size(), 1000u );
+	for( int i = 0; i < 1000; ++i )
+	{
+		const string key = "key" + boost::lexical_cast<string>( i );
+		const StringMap<int>::iterator found = map.find( key );
+		BOOST_REQUIRE( found != map.end() );
+		BOOST_CHECK_EQUAL( found->second, i );
+		// kept in insertion order
+		BOOST_CHECK_EQUAL( map.index( found ), size_t( i ) );
+		BOOST_CHECK_EQUAL( map[i].first, key );
+	}
+	BOOST_CHECK( map.find( "key1000" ) == map.end() );
+	BOOST_CHECK_EQUAL( StringMap<int>::hash( "key1" ), boost::hash<string>()( "key1" ) );
+
+	StringMap<int> copy( map );
+	map.clear();
+	BOOST_CHECK( map.empty() );
+	BOOST_CHECK( map.find( "key1" ) == map.end() );
+	BOOST_CHECK_EQUAL( copy.find( "key1" )->second, 1 );
+	copy.reserve( 100000 );
+	BOOST_CHECK_EQUAL( copy.find( "key999" )->second, 999 );
+}
+
+BOOST_AUTO_TEST_CASE( SingleFilesTest )
+{
+	parser::Statistics statistics;
+	Parser parser;
+	parser.setStatistics( &statistics );
+	parser.insert( "dump/a3f9c0e1.jpg" );
+	parser.insert( "dump/b17d22e0.jpg" );
+	parser.insert( "dump/IMG_0042.JPG" );
+	parser.insert( "dump/README" );
+	parser.insert( "dump/README" );
+	BrowseItems items = parser.getResults();
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_REQUIRE_EQUAL( items.size(), 4u );
+	BOOST_CHECK( items[0] == create_file( "dump/IMG_0042.JPG" ) );
+	BOOST_CHECK( items[1] == create_file( "dump/README" ) );
+	BOOST_CHECK( items[2] == create_file( "dump/a3f9c0e1.jpg" ) );
+	BOOST_CHECK( items[3] == create_file( "dump/b17d22e0.jpg" ) );
+	// neither prepared nor split
+	BOOST_CHECK_EQUAL( statistics.patterns, 3u );
+	BOOST_CHECK_EQUAL( statistics.splits, 0u );
+	BOOST_CHECK_EQUAL( statistics.bytesAllocated, 0u );
+}
+
+BOOST_AUTO_TEST_CASE( MergeAndSerializeTest )
+{
+	vector<string> paths;
+	for( int frame = 1; frame <= 30; ++frame )
+	{
+		paths.push_back( "/s/a/comp_v1." + boost::lexical_cast<string>( frame ) + ".exr" );
+		paths.push_back( "/s/a/comp_v2." + boost::lexical_cast<string>( frame ) + ".exr" );
+		paths.push_back( "/s/b/long." + boost::lexical_cast<string>( 1000000000 + frame ) + ".exr" );
+	}
+	paths.push_back( "/s/b/notes.txt" );
+	paths.push_back( "/s/b/notes.txt" );
+
+	Parser whole;
+	for_each( paths.begin(), paths.end(), whole.functor() );
+	BrowseItems expected = whole.getResults();
+	sort( expected.begin(), expected.end(), pathLess );
+
+	Parser first, second;
+	for( size_t i = 0; i < paths.size(); ++i )
+		( i % 3 ? first : second ).insert( paths[i] );
+	first.merge( second );
+	BrowseItems items = first.getResults();
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_CHECK( items == expected );
+	BOOST_CHECK( second.getResults().empty() );
+	BOOST_CHECK_THROW( first.merge( second ), std::logic_error );
+
+	Parser saved, reduced;
+	for( size_t i = 0; i < paths.size(); ++i )
+		( i % 2 ? saved : reduced ).insert( paths[i] );
+	stringstream state;
+	saved.save( state );
+	reduced.load( state );
+	items = reduced.getResults();
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_CHECK( items == expected );
+
+	const string truncated = state.str().substr( 0, state.str().size() / 2 );
+	stringstream broken( truncated );
+	Parser failing;
+	BOOST_CHECK_THROW( failing.load( broken ), std::runtime_error );
+	stringstream garbage( "not a state" );
+	BOOST_CHECK_THROW( failing.load( garbage ), std::runtime_error );
+
+	// a corrupted value count is not allocated before the truncation is noticed
+	Parser single;
+	single.insert( "d/a1" );
+	stringstream singleState;
+	single.save( singleState );
+	string corrupted = singleState.str();
+	// the count precedes the 16 bits value and the regular, wide and files counts
+	const size_t countOffset = corrupted.size() - 2 - 3 * 8 - 8;
+	const boost::uint64_t hugeCount = boost::uint64_t( 1 ) << 40;
+	corrupted.replace( countOffset, 8, reinterpret_cast<const char*>( &hugeCount ), 8 );
+	stringstream huge( corrupted );
+	BOOST_CHECK_THROW( failing.load( huge ), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( ReleaseColumnsTest )
+{
+	vector<string> paths;
+	for( int frame = 1; frame <= 30; ++frame )
+	{
+		paths.push_back( "/s/a/comp_v1." + boost::lexical_cast<string>( frame ) + ".exr" );
+		paths.push_back( "/s/a/comp_v2." + boost::lexical_cast<string>( frame ) + ".exr" );
+		paths.push_back( "/s/b/long." + boost::lexical_cast<string>( 10000000000ll + frame ) + ".exr" );
+	}
+	paths.push_back( "/s/b/notes.txt" );
+	paths.push_back( "top.txt" );
+
+	Parser items;
+	for_each( paths.begin(), paths.end(), items.functor() );
+	BrowseItems expected = items.getResults();
+	sort( expected.begin(), expected.end(), pathLess );
+	parser::Columns columns;
+	BOOST_CHECK_THROW( items.releaseColumns( columns ), std::logic_error );
+
+	Parser parser;
+	for_each( paths.begin(), paths.end(), parser.functor() );
+	parser.releaseColumns( columns );
+	BOOST_REQUIRE_EQUAL( columns.size(), expected.size() );
+	BrowseItems rebuilt;
+	for( size_t i = 0; i < columns.size(); ++i )
+		rebuilt.push_back( columns.item( i ) );
+	sort( rebuilt.begin(), rebuilt.end(), pathLess );
+	BOOST_CHECK( rebuilt == expected );
+	// "", /s/a, comp_v1., .exr, comp_v2., /s/b, 30 long files, notes.txt, top.txt
+	BOOST_CHECK_EQUAL( columns.strings.size(), 6u + 30u + 2u );
+}
+
+BOOST_AUTO_TEST_CASE( NaturalSortTest )
+{
+	BOOST_CHECK( parser::naturalLess( "shot2", "shot10" ) );
+	BOOST_CHECK( !parser::naturalLess( "shot10", "shot2" ) );
+	BOOST_CHECK( parser::naturalLess( "img.9.exr", "img.0010.exr" ) );
+	BOOST_CHECK( parser::naturalLess( "img.exr", "img1.exr" ) );
+	BOOST_CHECK( parser::naturalLess( "a-1", "a1" ) );
+	BOOST_CHECK_EQUAL( parser::naturalKey( "v007" ), parser::naturalKey( "v7" ) );
+	BOOST_CHECK_EQUAL( parser::naturalKey( "v000" ), parser::naturalKey( "v0" ) );
+
+	BrowseItems expected;
+	expected.push_back( create_sequence( "/s", SequencePattern( "img.", ".exr", 4 ), Range( 5, 10 ) ) );
+	expected.push_back( create_sequence( "/s", SequencePattern( "img.", ".exr", 4 ), Range( 100, 200 ) ) );
+	expected.push_back( create_file( "/s/img.txt" ) );
+	expected.push_back( create_folder( "/s/shot2" ) );
+	expected.push_back( create_folder( "/s/shot10" ) );
+	expected.push_back( create_file( "/s/shot2/b.txt" ) );
+	expected.push_back( create_file( "/s/shot10/a.txt" ) );
+	BrowseItems items( expected.rbegin(), expected.rend() );
+	parser::sortItems( items );
+	BOOST_CHECK( items == expected );
+
+	// a sub directory stays next to its parent
+	BrowseItems siblings;
+	siblings.push_back( create_file( "/s/a/c.txt" ) );
+	siblings.push_back( create_file( "/s/a/x/c.txt" ) );
+	siblings.push_back( create_file( "/s/a b/c.txt" ) );
+	siblings.push_back( create_file( "/s/a.b/c.txt" ) );
+	items.assign( siblings.rbegin(), siblings.rend() );
+	parser::sortItems( items );
+	BOOST_CHECK( items == siblings );
+
+	// large enough to be sorted concurrently
+	BrowseItems many;
+	for( int i = 0; i < 20000; ++i )
+		many.push_back( create_file( "/s/d" + boost::lexical_cast<string>( i % 7 ) + "/f" + boost::lexical_cast<string>( ( i * 7919 ) % 20000 ) + ".txt" ) );
+	BrowseItems reversed( many.rbegin(), many.rend() );
+	parser::sortItems( many, 1 );
+	parser::sortItems( reversed, 3 );
+	BOOST_CHECK( many == reversed );
+	for( size_t i = 1; i < many.size(); ++i )
+	{
+		const bool sameDirectory = many[i - 1].path.parent_path() == many[i].path.parent_path();
+		BOOST_CHECK( sameDirectory ?
+					 parser::naturalLess( many[i - 1].path.filename().string(), many[i].path.filename().string() ) :
+					 parser::naturalLess( many[i - 1].path.parent_path().string(), many[i].path.parent_path().string() ) );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( SplitStrategyTest )
+{
+	vector<string> paths;
+	for( int size = 0; size < 6; ++size )
+		for( int frame = 1; frame <= 3; ++frame )
+			paths.push_back( "img_" + boost::lexical_cast<string>( 1280 + 64 * size ) + "x" + boost::lexical_cast<string>( 720 + 36 * size ) +
+							 "_000" + boost::lexical_cast<string>( frame ) + ".exr" );
+
+	parser::Statistics statistics;
+	Parser parser;
+	parser.setStatistics( &statistics );
+	for_each( paths.begin(), paths.end(), parser.functor() );
+	BrowseItems items = parser.getResults();
+	// one sequence of frames per resolution
+	BOOST_REQUIRE_EQUAL( items.size(), 6u );
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_CHECK( items[0] == create_sequence( "", SequencePattern( "img_1280x720_", ".exr", 4 ), Range( 1, 3 ) ) );
+	BOOST_CHECK_EQUAL( statistics.patterns, 1u + 6u );
+
+	// the frame number having the fewest values, files are grouped by frame then by resolution
+	parser::Statistics legacyStatistics;
+	Parser legacy;
+	legacy.setStatistics( &legacyStatistics );
+	legacy.setSplitStrategy( parser::SPLIT_FEWEST_VALUES );
+	for_each( paths.begin(), paths.end(), legacy.functor() );
+	BOOST_CHECK_EQUAL( legacy.getResults().size(), 18u );
+	BOOST_CHECK_EQUAL( legacyStatistics.patterns, 1u + 3u + 18u );
+}
+
+BOOST_AUTO_TEST_CASE( LatestVersionTest )
+{
+	vector<string> paths;
+	for( int frame = 1; frame <= 10; ++frame )
+	{
+		const string suffix = boost::lexical_cast<string>( 1000 + frame ) + ".exr";
+		paths.push_back( "/s/sh010_comp_v001." + suffix );
+		paths.push_back( "/s/sh010_comp_v002." + suffix );
+		paths.push_back( "/s/sh020_comp_v001." + suffix );
+		if( frame <= 5 )
+			paths.push_back( "/s/sh010_comp_v003." + suffix );
+	}
+	paths.push_back( "/s/notes_v1.txt" );
+	paths.push_back( "/s/notes_v2.txt" );
+	paths.push_back( "/s/take1.txt" );
+	paths.push_back( "/s/take2.txt" );
+
+	Parser parser;
+	parser.setVersionPrefix( "_v" );
+	for_each( paths.begin(), paths.end(), parser.functor() );
+	BrowseItems items = parser.getResults();
+	sort( items.begin(), items.end(), pathLess );
+
+	BrowseItems expected;
+	expected.push_back( create_file( "/s/notes_v2.txt" ) );
+	expected.push_back( create_sequence( "/s", SequencePattern( "sh010_comp_v003.", ".exr", 4 ), Range( 1001, 1005 ) ) );
+	expected.push_back( create_sequence( "/s", SequencePattern( "sh020_comp_v001.", ".exr", 4 ), Range( 1001, 1010 ) ) );
+	expected.push_back( create_sequence( "/s", SequencePattern( "take", ".txt", 1 ), Range( 1, 2 ) ) );
+	sort( expected.begin(), expected.end(), pathLess );
+	BOOST_CHECK( items == expected );
+
+	Parser all;
+	for_each( paths.begin(), paths.end(), all.functor() );
+	BOOST_CHECK_EQUAL( all.getResults().size(), 6u );
+
+	// a number before the version is not a frame number
+	Parser shots;
+	shots.setVersionPrefix( "_v" );
+	shots.insert( "/s/sh010_comp_v001.ma" );
+	shots.insert( "/s/sh020_comp_v002.ma" );
+	shots.insert( "/s/sh030_comp_v001.ma" );
+	shots.insert( "/s/sh030_comp_v003.ma" );
+	items = shots.getResults();
+	sort( items.begin(), items.end(), pathLess );
+	expected.clear();
+	expected.push_back( create_file( "/s/sh010_comp_v001.ma" ) );
+	expected.push_back( create_file( "/s/sh020_comp_v002.ma" ) );
+	expected.push_back( create_file( "/s/sh030_comp_v003.ma" ) );
+	BOOST_CHECK( items == expected );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/**
+ * Creates a temporary folder removed at the end of the test
+ */
+struct TemporaryFolder
+{
+	TemporaryFolder() :
+		folder( boost::filesystem::temp_directory_path() / boost::filesystem::unique_path() )
+	{
+		boost::filesystem::create_directories( folder );
+	}
+
+	~TemporaryFolder()
+	{
+		boost::system::error_code ignored;
+		boost::filesystem::remove_all( folder, ignored );
+	}
+
+	void createFile( const string &filename, size_t size ) const
+	{
+		boost::filesystem::ofstream file( folder / filename );
+		file << string( size, 'x' );
+	}
+
+	boost::filesystem::path folder;
+};
+
+/**
+ * a.001.exr, a.002.exr and shot/notes.txt, the directories being modified
+ * long enough ago for their listings to be cached
+ */
+struct CacheableFolder : TemporaryFolder
+{
+	CacheableFolder() :
+		past( time( NULL ) - 60 )
+	{
+		createFile( "a.001.exr", 1 );
+		createFile( "a.002.exr", 2 );
+		boost::filesystem::create_directories( folder / "shot" );
+		createFile( "shot/notes.txt", 3 );
+		boost::filesystem::last_write_time( folder, past );
+		boost::filesystem::last_write_time( folder / "shot", past );
+	}
+
+	const time_t past;
+};
+
+BOOST_AUTO_TEST_SUITE( BrowsingSuite )
+
+static void checkMetadata( const BrowseItems &items )
+{
+	BOOST_CHECK_EQUAL( items.size(), 3u );
+	for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+	{
+		const Metadata &metadata = itr->sequence.metadata;
+		switch( itr->type )
+		{
+			case SEQUENCE:
+				BOOST_CHECK_EQUAL( metadata.count, 3u );
+				BOOST_CHECK_EQUAL( metadata.size, 10u + 20u + 30u );
+				BOOST_CHECK( metadata.minTime <= metadata.maxTime );
+				BOOST_CHECK( metadata.minTime > 0 );
+				break;
+			case UNITFILE:
+				BOOST_CHECK_EQUAL( metadata.count, 1u );
+				BOOST_CHECK_EQUAL( metadata.size, 5u );
+				break;
+			case FOLDER:
+				BOOST_CHECK( metadata.empty() );
+				break;
+			default:
+				BOOST_ERROR( "unexpected item" );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( MetadataTest )
+{
+	TemporaryFolder tmp;
+	tmp.createFile( "frame.0001.exr", 10 );
+	tmp.createFile( "frame.0002.exr", 20 );
+	tmp.createFile( "frame.0003.exr", 30 );
+	tmp.createFile( "notes.txt", 5 );
+	boost::filesystem::create_directory( tmp.folder / "subfolder" );
+
+	const string folder = tmp.folder.string();
+	BOOST_CHECK( parser::browse( folder.c_str() ).front().sequence.metadata.empty() );
+
+	parser::BrowseOptions options;
+	options.gatherMetadata = true;
+	checkMetadata( parser::browse( folder.c_str(), options ) );
+
+	BrowseItems items = parser::browse( folder.c_str() );
+	parser::gatherMetadata( items, parser::METADATA_THREADS, 2 );
+	checkMetadata( items );
+
+	items = parser::browse( folder.c_str() );
+	parser::gatherMetadata( items, parser::METADATA_IO_URING );
+	checkMetadata( items );
+}
+
+BOOST_AUTO_TEST_CASE( BrowseManyTest )
+{
+	TemporaryFolder first;
+	first.createFile( "a.001.exr", 1 );
+	first.createFile( "a.002.exr", 1 );
+	TemporaryFolder second;
+	second.createFile( "notes.txt", 1 );
+	second.createFile( "b.1.dpx", 1 );
+	second.createFile( "b.2.dpx", 1 );
+
+	vector<string> directories;
+	directories.push_back( first.folder.string() );
+	directories.push_back( second.folder.string() );
+	directories.push_back( first.folder.string() );
+	parser::Statistics statistics;
+	parser::BrowseOptions options;
+	options.statistics = &statistics;
+	const vector<BrowseItems> results = parser::browseMany( directories, options, 2 );
+	BOOST_REQUIRE_EQUAL( results.size(), 3u );
+	BOOST_CHECK_EQUAL( results[0].size(), 1u );
+	BOOST_CHECK_EQUAL( results[1].size(), 2u );
+	BOOST_CHECK( results[0] == results[2] );
+	BOOST_CHECK_EQUAL( statistics.entries, 2u + 3u + 2u );
+
+	directories.push_back( ( first.folder / "missing" ).string() );
+	BOOST_CHECK_THROW( parser::browseMany( directories, parser::BrowseOptions() ), std::ios_base::failure );
+}
+
+BOOST_AUTO_TEST_CASE( BrowseStatisticsTest )
+{
+	TemporaryFolder tmp;
+	// numbered directories are reported as a single sequence
+	for( int i = 1; i <= 3; ++i )
+		boost::filesystem::create_directories( tmp.folder / ( "shot" + boost::lexical_cast<string>( i ) ) / "comp" );
+	tmp.createFile( "shot1/comp/frame.1.exr", 1 );
+	tmp.createFile( "notes.txt", 1 );
+	const string folder = tmp.folder.string();
+
+	parser::Statistics statistics;
+	parser::BrowseOptions options;
+	options.recursive = true;
+	options.statistics = &statistics;
+	parser::browse( folder.c_str(), options );
+	BOOST_CHECK_EQUAL( statistics.directories, 7u ); // root, 3 shots and their comp
+	BOOST_CHECK_EQUAL( statistics.entries, 8u );
+	// opening the directories, reading the entries and checking which of the 5 unit files are folders
+	BOOST_CHECK_EQUAL( statistics.syscalls, 7u + 8u + 5u );
+
+	statistics.reset();
+	options.gatherMetadata = true;
+	parser::browse( folder.c_str(), options );
+	BOOST_CHECK_EQUAL( statistics.syscalls, 7u + 8u + 5u + 2u + 3u ); // and stat'ing 2 files and the 3 shots
+
+	statistics.reset();
+	options.gatherMetadata = false;
+	options.presize = true;
+	parser::browse( folder.c_str(), options );
+	BOOST_CHECK_EQUAL( statistics.syscalls, 7u + 8u + 5u + 7u ); // and stat'ing every directory to presize it
+}
+
+BOOST_AUTO_TEST_CASE( FollowSymlinksTest )
+{
+	TemporaryFolder tmp;
+	boost::filesystem::create_directory( tmp.folder / "a" );
+	tmp.createFile( "a/frame.1.exr", 1 );
+	tmp.createFile( "a/frame.2.exr", 1 );
+	// an alias of a and a loop back to the root
+	boost::filesystem::create_directory_symlink( tmp.folder / "a", tmp.folder / "b" );
+	boost::filesystem::create_directory_symlink( tmp.folder, tmp.folder / "a" / "loop" );
+	const string folder = tmp.folder.string();
+
+	parser::BrowseOptions options;
+	options.recursive = true;
+	BrowseItems items = parser::browse( folder.c_str(), options );
+	BOOST_CHECK_EQUAL( items.size(), 4u ); // a, b, a/loop and the sequence in a
+
+	parser::Statistics statistics;
+	options.followSymlinks = true;
+	options.statistics = &statistics;
+	items = parser::browse( folder.c_str(), options );
+	size_t sequences = 0;
+	for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+		if( itr->type == SEQUENCE )
+			++sequences;
+	BOOST_CHECK_EQUAL( items.size(), 4u );
+	BOOST_CHECK_EQUAL( sequences, 1u );
+	BOOST_CHECK_EQUAL( statistics.directories, 2u ); // root and a, b and a/loop lead to them
+
+	options.statistics = NULL;
+	parser::Walker walker( folder.c_str(), options );
+	size_t directories = 0;
+	while( walker.next( items ) )
+		++directories;
+	BOOST_CHECK_EQUAL( directories, 2u );
+}
+
+BOOST_AUTO_TEST_CASE( ColumnsTest )
+{
+	BrowseItems items;
+	items.push_back( create_folder( "/s/a" ) );
+	items.push_back( create_file( "/s/notes.txt" ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "file.", ".exr", 4 ), Range( 1, 100 ), 2 ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "file.", ".dpx", 1 ), Range( 5, 6 ) ) );
+
+	const parser::Columns columns = parser::toColumns( items );
+	BOOST_REQUIRE_EQUAL( columns.size(), items.size() );
+	BOOST_CHECK_EQUAL( columns.types[2], SEQUENCE );
+	BOOST_CHECK_EQUAL( columns.lasts[2], 100u );
+	BOOST_CHECK_EQUAL( columns.directories[0], columns.directories[3] );
+	BOOST_CHECK_EQUAL( columns.prefixes[2], columns.prefixes[3] );
+	BOOST_CHECK_EQUAL( columns.strings.size(), 7u ); // "", /s, a, notes.txt, file., .exr, .dpx
+	for( size_t i = 0; i < items.size(); ++i )
+		BOOST_CHECK( columns.item( i ) == items[i] );
+}
+
+BOOST_AUTO_TEST_CASE( WalkerTest )
+{
+	TemporaryFolder tmp;
+	tmp.createFile( "a.001.exr", 1 );
+	tmp.createFile( "a.002.exr", 1 );
+	boost::filesystem::create_directories( tmp.folder / "shot" / "comp" );
+	tmp.createFile( "shot/notes.txt", 1 );
+	tmp.createFile( "shot/comp/c.1.dpx", 1 );
+	tmp.createFile( "shot/comp/c.2.dpx", 1 );
+	// reported as a sequence but still walked into
+	boost::filesystem::create_directories( tmp.folder / "take" / "01" );
+	boost::filesystem::create_directories( tmp.folder / "take" / "02" );
+	tmp.createFile( "take/02/t.txt", 1 );
+	const string folder = tmp.folder.string();
+
+	parser::Walker flat( folder.c_str() );
+	BrowseItems items;
+	BOOST_CHECK( flat.next( items ) );
+	BOOST_CHECK_EQUAL( items.size(), 3u );
+	BOOST_CHECK( !flat.next( items ) );
+	BOOST_CHECK( items.empty() );
+
+	parser::BrowseOptions options;
+	options.recursive = true;
+	parser::Walker walker( folder.c_str(), options );
+	BrowseItems all;
+	size_t directories = 0;
+	while( walker.next( items ) )
+	{
+		++directories;
+		for( BrowseItems::const_iterator itr = items.begin(); itr != items.end(); ++itr )
+			BOOST_CHECK( itr->path == walker.directory() || itr->path.parent_path() == walker.directory() );
+		all.insert( all.end(), items.begin(), items.end() );
+	}
+	BOOST_CHECK_EQUAL( directories, 6u );
+	BrowseItems expected = parser::browse( folder.c_str(), true );
+	sort( all.begin(), all.end(), pathLess );
+	sort( expected.begin(), expected.end(), pathLess );
+	BOOST_CHECK( all == expected );
+}
+
+BOOST_AUTO_TEST_CASE( PathListTest )
+{
+	string list;
+	Parser parser;
+	for( int shot = 0; shot < 20; ++shot )
+	{
+		for( int frame = 1; frame <= 50; ++frame )
+		{
+			const string path = "/show/shot" + boost::lexical_cast<string>( shot ) + "/comp." + boost::lexical_cast<string>( frame ) + ".exr";
+			parser.insert( path );
+			list += path + ( frame % 2 ? "\r\n" : "\n" );
+		}
+		parser.insert( "/show/shot" + boost::lexical_cast<string>( shot ) + "/notes.txt" );
+		list += "/show/shot" + boost::lexical_cast<string>( shot ) + "/notes.txt\n\n";
+	}
+	BrowseItems expected = parser.getResults();
+	sort( expected.begin(), expected.end(), pathLess );
+
+	parser::Statistics statistics;
+	for( size_t threads = 1; threads <= 4; ++threads )
+	{
+		BrowseItems items = parser::parseLines( list.data(), list.data() + list.size(), threads, &statistics );
+		sort( items.begin(), items.end(), pathLess );
+		BOOST_CHECK( items == expected );
+	}
+	BOOST_CHECK_EQUAL( statistics.entries, 4u * 20u * 51u );
+
+	TemporaryFolder tmp;
+	{
+		boost::filesystem::ofstream file( tmp.folder / "list.txt" );
+		file << list;
+	}
+	BrowseItems items = parser::parseList( ( tmp.folder / "list.txt" ).string().c_str() );
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_CHECK( items == expected );
+	tmp.createFile( "empty.txt", 0 );
+	BOOST_CHECK( parser::parseList( ( tmp.folder / "empty.txt" ).string().c_str() ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE( SequenceIndexTest )
+{
+	BrowseItems items;
+	items.push_back( create_file( "/s/a/notes.txt" ) );
+	items.push_back( create_sequence( "/s/a", SequencePattern( "beauty_v2.", ".exr", 4 ), Range( 1, 100 ) ) );
+	items.push_back( create_sequence( "/s/a", SequencePattern( "beauty_v2.", ".exr", 4 ), Range( 200, 300 ), 10 ) );
+	items.push_back( create_sequence( "/s/b", SequencePattern( "beauty_v2.", ".exr", 1 ), Range( 1, 100 ) ) );
+	items.push_back( create_sequence( "/", SequencePattern( "root_", "", 1 ), Range( 0, 9 ) ) );
+	items.push_back( create_sequence( "/s/a", SequencePattern( "wide.", ".exr", 2 ), Range( 90, 110 ) ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "long.", ".exr", 1 ), Range( 1000000000, 1000000002 ) ) );
+
+	const parser::SequenceIndex index( items );
+	BOOST_CHECK_EQUAL( index.size(), 6u );
+	BOOST_CHECK_EQUAL( index.find( "/s/a/beauty_v2.0042.exr" ), 1u );
+	BOOST_CHECK_EQUAL( index.find( "/s/a/beauty_v2.0250.exr" ), 2u );
+	BOOST_CHECK_EQUAL( index.find( "/s/b/beauty_v2.42.exr" ), 3u );
+	BOOST_CHECK_EQUAL( index.find( "/root_7" ), 4u );
+	BOOST_CHECK_EQUAL( index.find( "/s/a/wide.105.exr" ), 5u ); // wider than the padding
+	BOOST_CHECK_EQUAL( index.find( "/s/a/wide.95.exr" ), 5u );
+	BOOST_CHECK( !index.contains( "/s/a/wide.0105.exr" ) );
+	BOOST_CHECK_EQUAL( index.find( "/s/long.1000000001.exr" ), 6u ); // ten digits
+	BOOST_CHECK( !index.contains( "/s/long.9999999999.exr" ) );      // past 32 bits
+	BOOST_CHECK( !index.contains( "/s/a/beauty_v2.0255.exr" ) ); // step
+	BOOST_CHECK( !index.contains( "/s/a/beauty_v2.0150.exr" ) ); // hole
+	BOOST_CHECK( !index.contains( "/s/a/beauty_v2.42.exr" ) );   // padding
+	BOOST_CHECK( !index.contains( "/s/b/beauty_v2.042.exr" ) );
+	BOOST_CHECK( !index.contains( "/s/a/beauty_v3.0042.exr" ) );
+	BOOST_CHECK( !index.contains( "/s/a/notes.txt" ) );
+	BOOST_CHECK( !index.contains( "/s/c/beauty_v2.0042.exr" ) );
+
+	vector<string> paths;
+	for( int i = 0; i < 10000; ++i )
+		paths.push_back( i % 2 ? "/s/a/beauty_v2.0042.exr" : "/s/b/missing.1.exr" );
+	const vector<size_t> found = index.find( paths, 4 );
+	BOOST_REQUIRE_EQUAL( found.size(), paths.size() );
+	BOOST_CHECK_EQUAL( found[0], parser::SequenceIndex::npos );
+	BOOST_CHECK_EQUAL( found[9999], 1u );
+}
+
+#ifdef SEQUENCEPARSER_HAS_DAEMON
+BOOST_AUTO_TEST_CASE( DaemonTest )
+{
+	CacheableFolder tmp;
+	const time_t past = tmp.past;
+	const string folder = tmp.folder.string();
+	const string socketPath = ( tmp.folder / "lssd.sock" ).string();
+
+	parser::DaemonServer server( socketPath );
+	boost::thread serving( boost::bind( &parser::DaemonServer::run, &server, 2 ) );
+	parser::DaemonCounters counters;
+	{
+		parser::DaemonClient client( socketPath );
+		// the socket was created after the listing so the directory is listed again
+		boost::filesystem::last_write_time( tmp.folder, past );
+		BrowseItems expected = parser::browse( folder.c_str() );
+		BrowseItems items = client.browse( folder.c_str() );
+		sort( expected.begin(), expected.end(), pathLess );
+		sort( items.begin(), items.end(), pathLess );
+		BOOST_CHECK( items == expected );
+		BrowseItems cached = client.browse( folder.c_str() );
+		sort( cached.begin(), cached.end(), pathLess );
+		BOOST_CHECK( cached == items );
+
+		parser::BrowseOptions options;
+		options.recursive = true;
+		options.gatherMetadata = true;
+		expected = parser::browse( folder.c_str(), options );
+		items = client.browse( folder.c_str(), options );
+		sort( expected.begin(), expected.end(), pathLess );
+		sort( items.begin(), items.end(), pathLess );
+		BOOST_CHECK( items == expected );
+		for( size_t i = 0; i < items.size(); ++i )
+			BOOST_CHECK_EQUAL( items[i].sequence.metadata.size, expected[i].sequence.metadata.size );
+
+		tmp.createFile( "b.txt", 1 );
+		boost::filesystem::last_write_time( tmp.folder, past + 1 );
+		BOOST_CHECK_EQUAL( client.browse( folder.c_str() ).size(), 4u ); // a, shot, lssd.sock and b.txt
+
+		BOOST_CHECK_THROW( client.browse( ( folder + "/missing" ).c_str() ), std::ios_base::failure );
+		BOOST_CHECK_EQUAL( client.browse( folder.c_str() ).size(), 4u );
+		counters = server.counters();
+
+		// the options changing the results are honored
+		options.gatherMetadata = false;
+		options.sorted = true;
+		options.splitStrategy = parser::SPLIT_FEWEST_VALUES;
+		expected = parser::browse( folder.c_str(), options );
+		BOOST_CHECK( client.browse( folder.c_str(), options ) == expected );
+		boost::filesystem::create_directory_symlink( tmp.folder / "shot", tmp.folder / "link" );
+		options.followSymlinks = true;
+		expected = parser::browse( folder.c_str(), options );
+		BOOST_CHECK( client.browse( folder.c_str(), options ) == expected );
+		parser::BrowseOptions latest( options );
+		latest.versionPrefix = "_v";
+		BOOST_CHECK_THROW( client.browse( folder.c_str(), latest ), std::ios_base::failure );
+	}
+	server.stop();
+	serving.join();
+	BOOST_CHECK( !boost::filesystem::exists( socketPath ) );
+
+	BOOST_CHECK_EQUAL( counters.requests, 6u );
+	BOOST_CHECK_EQUAL( counters.misses, 4u ); // folder, shot, folder modified, missing
+	BOOST_CHECK_EQUAL( counters.hits, 3u );
+	BOOST_CHECK_EQUAL( counters.directories, 2u );
+	BOOST_CHECK_THROW( parser::DaemonClient client( socketPath ), std::ios_base::failure );
+}
+#endif
+
+/**
+ * Browses 'folder' through the cache from several threads
+ */
+struct CachedBrowser
+{
+	CachedBrowser( parser::BrowseCache &cache, const string &folder, BrowseItems &items ) :
+		cache( cache ),
+		folder( folder ),
+		items( items )
+	{
+	}
+
+	void operator()()
+	{
+		parser::BrowseOptions options;
+		options.recursive = true;
+		for( int i = 0; i < 20; ++i )
+			items = cache.browse( folder.c_str(), options );
+	}
+
+	parser::BrowseCache &cache;
+	const string &folder;
+	BrowseItems &items;
+};
+
+static time_t gNow = 0;
+
+static time_t testClock()
+{
+	return gNow;
+}
+
+BOOST_AUTO_TEST_CASE( BrowseCacheTest )
+{
+	CacheableFolder tmp;
+	const time_t past = tmp.past;
+	const string folder = tmp.folder.string();
+
+	parser::BrowseCache cache;
+	parser::BrowseOptions options;
+	options.recursive = true;
+	options.gatherMetadata = true;
+	BrowseItems expected = parser::browse( folder.c_str(), options );
+	sort( expected.begin(), expected.end(), pathLess );
+	BrowseItems items = cache.browse( folder.c_str(), options );
+	sort( items.begin(), items.end(), pathLess );
+	BOOST_CHECK( items == expected );
+	for( size_t i = 0; i < items.size(); ++i )
+		BOOST_CHECK_EQUAL( items[i].sequence.metadata.size, expected[i].sequence.metadata.size );
+	BOOST_CHECK_EQUAL( cache.browse( folder.c_str() ).size(), 2u );
+
+	tmp.createFile( "b.txt", 1 );
+	boost::filesystem::last_write_time( tmp.folder, past + 1 );
+	BOOST_CHECK_EQUAL( cache.browse( folder.c_str() ).size(), 3u );
+	BOOST_CHECK_THROW( cache.browse( ( folder + "/missing" ).c_str() ), std::ios_base::failure );
+
+	parser::BrowseCacheCounters counters = cache.counters();
+	BOOST_CHECK_EQUAL( counters.misses, 4u ); // folder, shot, folder modified, missing
+	BOOST_CHECK_EQUAL( counters.hits, 1u );
+	BOOST_CHECK_EQUAL( counters.expired, 0u );
+	BOOST_CHECK_EQUAL( counters.directories, 2u );
+
+	// threads share the listings
+	const size_t threads = 4;
+	vector<BrowseItems> results( threads );
+	boost::thread_group group;
+	for( size_t i = 0; i < threads; ++i )
+		group.create_thread( CachedBrowser( cache, folder, results[i] ) );
+	group.join_all();
+	for( size_t i = 0; i < threads; ++i )
+		BOOST_CHECK_EQUAL( results[i].size(), 4u );
+	counters = cache.counters();
+	BOOST_CHECK_EQUAL( counters.hits, 1u + threads * 20u * 2u );
+	BOOST_CHECK_EQUAL( counters.misses, 4u );
+
+	cache.clear();
+	BOOST_CHECK_EQUAL( cache.counters().directories, 0u );
+
+	// listings outliving the ttl are listed again
+	gNow = time( NULL );
+	parser::BrowseCache expiring( parser::BrowseOptions(), 2, 16, 0, &testClock );
+	expiring.browse( folder.c_str() );
+	gNow += 1;
+	expiring.browse( folder.c_str() );
+	gNow += 1;
+	expiring.browse( folder.c_str() );
+	counters = expiring.counters();
+	BOOST_CHECK_EQUAL( counters.hits, 1u );
+	BOOST_CHECK_EQUAL( counters.misses, 2u );
+	BOOST_CHECK_EQUAL( counters.expired, 1u );
+
+	// the oldest listing makes room for another one in a full cache
+	parser::BrowseCache bounded( parser::BrowseOptions(), 0, 1, 1, &testClock );
+	bounded.listing( tmp.folder );
+	gNow += 1;
+	bounded.listing( tmp.folder / "shot" );
+	bounded.listing( tmp.folder / "shot" );
+	counters = bounded.counters();
+	BOOST_CHECK_EQUAL( counters.hits, 1u );
+	BOOST_CHECK_EQUAL( counters.evicted, 1u );
+	BOOST_CHECK_EQUAL( counters.directories, 1u );
+
+	// links are followed as browse() follows them, each directory once
+	boost::filesystem::create_directory_symlink( tmp.folder / "shot", tmp.folder / "link" );
+	parser::BrowseOptions following;
+	following.followSymlinks = true;
+	parser::BrowseCache followingCache( following );
+	following.recursive = true;
+	following.sorted = true;
+	BOOST_CHECK( followingCache.browse( folder.c_str(), following ) == parser::browse( folder.c_str(), following ) );
+}
+
+BOOST_AUTO_TEST_CASE( FlatItemsTest )
+{
+	BrowseItems items;
+	items.push_back( create_folder( "/s/a" ) );
+	items.push_back( create_file( "/s/notes.txt" ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "file.", ".exr", 4 ), Range( 1, 100 ), 2 ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "file.", ".dpx", 1 ), Range( 5, 6 ) ) );
+
+	ostringstream stream;
+	parser::writeFlat( stream, items );
+	const string flat = stream.str();
+	BOOST_CHECK_EQUAL( flat.size(), sizeof( parser::FlatHeader ) + 4 * sizeof( parser::FlatRecord ) + 8 * 4 + 25 );
+	// heap allocated, aligned enough to be read in place
+	const parser::FlatItems view( flat.data(), flat.size() );
+	BOOST_REQUIRE_EQUAL( view.size(), items.size() );
+	BOOST_CHECK_EQUAL( view.stringCount(), 7u ); // "", /s, a, notes.txt, file., .exr, .dpx
+	BOOST_CHECK_EQUAL( view.record( 2 ).last, 100u );
+	BOOST_CHECK_EQUAL( view.string( view.record( 3 ).suffix ), ".dpx" );
+	BOOST_CHECK_EQUAL( view.record( 2 ).directory, view.record( 3 ).directory );
+	for( size_t i = 0; i < items.size(); ++i )
+		BOOST_CHECK( view.item( i ) == items[i] );
+
+	TemporaryFolder tmp;
+	const string filename = ( tmp.folder / "items.flat" ).string();
+	parser::writeFlat( filename.c_str(), items );
+	const parser::FlatItems mapped( filename.c_str() );
+	BOOST_REQUIRE_EQUAL( mapped.size(), items.size() );
+	for( size_t i = 0; i < items.size(); ++i )
+		BOOST_CHECK( mapped.item( i ) == items[i] );
+
+	parser::writeFlat( filename.c_str(), BrowseItems() );
+	BOOST_CHECK_EQUAL( parser::FlatItems( filename.c_str() ).size(), 0u );
+
+	BOOST_CHECK_THROW( parser::FlatItems truncated( flat.data(), flat.size() - 1 ), std::ios_base::failure );
+	string corrupted( flat );
+	corrupted[0] = 'X';
+	BOOST_CHECK_THROW( parser::FlatItems invalid( corrupted.data(), corrupted.size() ), std::ios_base::failure );
+	// a record indexing a string past the strings section
+	corrupted = flat;
+	parser::FlatRecord record;
+	memcpy( &record, &corrupted[sizeof( parser::FlatHeader )], sizeof( record ) );
+	record.prefix = static_cast<boost::uint32_t>( view.stringCount() );
+	memcpy( &corrupted[sizeof( parser::FlatHeader )], &record, sizeof( record ) );
+	BOOST_CHECK_THROW( parser::FlatItems invalid( corrupted.data(), corrupted.size() ), std::ios_base::failure );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
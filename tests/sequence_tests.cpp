@@ -1,11 +1,17 @@
 #include <sequence/Range.h>
 #include <sequence/Sequence.h>
+#include <sequence/PatternMatcher.h>
 #include <sequence/BrowseItem.h>
+#include <sequence/DisplayUtils.h>
+#include <sequence/ItemWriter.h>
 
 #include <map>
 #include <ostream>
+#include <sstream>
+#include <cstdio>
 
 #include <boost/filesystem.hpp>
+#include <boost/rational.hpp>
 
 #define BOOST_TEST_MODULE Sequence
 #include <boost/test/unit_test.hpp>
@@ -98,6 +104,49 @@ BOOST_AUTO_TEST_CASE( range_offsets2 )
 	BOOST_CHECK_EQUAL( make_pair( 1u, true ), range.offsetClampFrame( 1, 1 ) );
 }
 
+BOOST_AUTO_TEST_CASE( range_offsets_beyond_duration )
+{
+	Range range( 5, 10 );
+	BOOST_CHECK_EQUAL( make_pair( 10u, true ), range.offsetLoopFrame( 7, 9 ) );
+	BOOST_CHECK_EQUAL( make_pair(  7u, true ), range.offsetLoopFrame( 7, 12 ) );
+	BOOST_CHECK_EQUAL( make_pair(  5u, true ), range.offsetLoopFrame( 7, -8 ) );
+	BOOST_CHECK_EQUAL( make_pair(  9u, true ), range.offsetLoopFrame( 5, -2147483647 - 1 ) );
+	BOOST_CHECK_EQUAL( make_pair( 10u, true ), range.offsetClampFrame( 7, 2147483647 ) );
+}
+
+BOOST_AUTO_TEST_CASE( range_batch_offsets )
+{
+	const Range range( 5, 10 );
+	vector<unsigned int> current;
+	vector<int> offsets;
+	for( unsigned int frame = range.first; frame <= range.last; ++frame )
+	{
+		for( int offset = -20; offset <= 20; ++offset )
+		{
+			current.push_back( frame );
+			offsets.push_back( offset );
+		}
+	}
+	const size_t count = current.size();
+	vector<unsigned int> frames( count );
+	bool *moved = new bool[count];
+	range.offsetClampFrames( &current[0], &offsets[0], count, &frames[0], moved );
+	for( size_t i = 0; i < count; ++i )
+	{
+		const Range::MoveResult expected = range.offsetClampFrame( current[i], offsets[i] );
+		BOOST_CHECK_EQUAL( make_pair( frames[i], moved[i] ), expected );
+		BOOST_CHECK_EQUAL( frames[i], range.clampFrame( int( current[i] ) + offsets[i] < 0 ? 0 : current[i] + offsets[i] ) );
+	}
+	range.offsetLoopFrames( &current[0], &offsets[0], count, &frames[0], moved );
+	for( size_t i = 0; i < count; ++i )
+	{
+		BOOST_CHECK_EQUAL( make_pair( frames[i], moved[i] ), range.offsetLoopFrame( current[i], offsets[i] ) );
+		BOOST_CHECK_EQUAL( ( int( frames[i] ) - int( current[i] ) - offsets[i] ) % 6, 0 );
+	}
+	delete[] moved;
+	range.offsetLoopFrames( &current[0], &offsets[0], count, &frames[0] );
+}
+
 BOOST_AUTO_TEST_CASE( range_clamp )
 {
 	{
@@ -195,6 +244,47 @@ BOOST_AUTO_TEST_CASE( subsampling_ranges )
 	}
 }
 
+// the former implementation, kept as a reference
+static unsigned int rationalInterpolateSource( const unsigned int recFrame, const Range &source, const Range &record, const bool reverse )
+{
+	typedef boost::rational<int64_t> Rational;
+	Rational recDuration = record.last - record.first;
+	Rational srcDuration = source.last - source.first;
+	if( recDuration > srcDuration )
+	{
+		++recDuration;
+		++srcDuration;
+	}
+	const Rational recOffset = reverse ? record.last - recFrame : recFrame - record.first;
+	const Rational srcOffset = recDuration == 0 ? 0 : ( recOffset * srcDuration / recDuration );
+	return boost::rational_cast<unsigned int>( srcOffset + source.first );
+}
+
+BOOST_AUTO_TEST_CASE( integer_interpolation )
+{
+	const unsigned int bounds[] = { 0, 1, 2, 3, 7, 24, 25, 99, 1000, 1001 };
+	const size_t boundCount = sizeof( bounds ) / sizeof( bounds[0] );
+	for( size_t a = 0; a < boundCount; ++a )
+	for( size_t b = a; b < boundCount; ++b )
+	for( size_t c = 0; c < boundCount; ++c )
+	for( size_t d = c; d < boundCount; ++d )
+	{
+		const Range source( 1000 + bounds[a], 1000 + bounds[b] );
+		const Range record( bounds[c], bounds[d] );
+		for( int reverse = 0; reverse < 2; ++reverse )
+		{
+			const vector<unsigned int> frames = interpolateSources( source, record, reverse );
+			BOOST_REQUIRE_EQUAL( frames.size(), record.duration() );
+			for( unsigned int frame = record.first; frame <= record.last; ++frame )
+			{
+				const unsigned int expected = rationalInterpolateSource( frame, source, record, reverse );
+				BOOST_REQUIRE_EQUAL( interpolateSource( frame, source, record, reverse ), expected );
+				BOOST_REQUIRE_EQUAL( frames[frame - record.first], expected );
+			}
+		}
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE( SequenceTestSuite )
@@ -238,6 +328,54 @@ BOOST_AUTO_TEST_CASE( instanciate_pattern_test )
 	}
 }
 
+BOOST_AUTO_TEST_CASE( match_pattern_test )
+{
+	const SequencePattern padded( "a_long_prefix_for_sse.", ".exr", 4 );
+	BOOST_CHECK( padded.match( "a_long_prefix_for_sse.0042.exr" ) );
+	BOOST_CHECK( !padded.match( "a_long_prefix_for_sse.42.exr" ) );
+	// wider frames are not padded
+	BOOST_CHECK( padded.match( "a_long_prefix_for_sse.12345.exr" ) );
+	BOOST_CHECK( !padded.match( "a_long_prefix_for_sse.01234.exr" ) );
+	BOOST_CHECK( !padded.match( "a_long_prefix_for_sse.00a2.exr" ) );
+	BOOST_CHECK( !padded.match( "a_long_prefix_for_sse.0042.dpx" ) );
+	BOOST_CHECK( !padded.match( "b_long_prefix_for_sse.0042.exr" ) );
+	BOOST_CHECK( !padded.match( ".exr" ) );
+	const SequencePattern unpadded( "a.", ".exr", 1 );
+	BOOST_CHECK( unpadded.match( "a.1234.exr" ) );
+	BOOST_CHECK( unpadded.match( "a.0.exr" ) );
+	BOOST_CHECK( !unpadded.match( "a.01.exr" ) );
+	BOOST_CHECK( !unpadded.match( "a..exr" ) );
+	BOOST_CHECK( !unpadded.match( "a.99999999999.exr" ) );
+}
+
+BOOST_AUTO_TEST_CASE( pattern_matcher_test )
+{
+	const SequencePattern pattern( "beauty.", ".exr", 4 );
+	const PatternMatcher matcher( pattern );
+	unsigned int frame = 0;
+	BOOST_CHECK( matcher.match( "beauty.0042.exr", frame ) );
+	BOOST_CHECK_EQUAL( frame, 42u );
+	BOOST_CHECK( matcher.match( "beauty.12345.exr", frame ) );
+	BOOST_CHECK_EQUAL( frame, 12345u );
+
+	const string block = "beauty.0001.exr\nbeauty.0002.exr\nnotes.txt\nbeauty.0004.exr";
+	vector<unsigned int> frames;
+	BOOST_CHECK_EQUAL( matcher.matchBlock( block.data(), block.data() + block.size(), '\n', frames ), 3u );
+	BOOST_REQUIRE_EQUAL( frames.size(), 3u );
+	BOOST_CHECK_EQUAL( frames[2], 4u );
+
+	vector<string> filenames;
+	filenames.push_back( "beauty.0005.exr" );
+	filenames.push_back( "beauty.5.exr" );
+	BOOST_CHECK_EQUAL( matcher.match( filenames, frames ), 1u );
+
+	const vector<unsigned int> missing = missingFrames( Sequence( pattern, Range( 1, 7 ) ), frames );
+	BOOST_REQUIRE_EQUAL( missing.size(), 3u );
+	BOOST_CHECK_EQUAL( missing[0], 3u );
+	BOOST_CHECK_EQUAL( missing[1], 6u );
+	BOOST_CHECK_EQUAL( missing[2], 7u );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE( BrowseItemTestSuite )
@@ -271,3 +409,59 @@ BOOST_AUTO_TEST_CASE( browse_item_test )
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE( ItemWriterTestSuite )
+
+static string writeItems( const vector<BrowseItem> &items, OutputFormat format, size_t bufferSize )
+{
+	FILE *file = tmpfile();
+	BOOST_REQUIRE( file );
+	{
+		ItemWriter writer( file, format, bufferSize );
+		writer.write( items.begin(), items.end() );
+	}
+	string content( ftell( file ), '\0' );
+	rewind( file );
+	if( !content.empty() )
+		BOOST_REQUIRE_EQUAL( fread( &content[0], 1, content.size(), file ), content.size() );
+	fclose( file );
+	return content;
+}
+
+static vector<BrowseItem> sampleItems()
+{
+	vector<BrowseItem> items;
+	items.push_back( create_folder( "/s/folder" ) );
+	items.push_back( create_file( "/s/a \"quoted\" & file.txt" ) );
+	items.push_back( create_sequence( "/s", SequencePattern( "beauty.", ".exr", 4 ), Range( 1, 100 ) ) );
+	items.push_back( create_sequence( "/s/", SequencePattern( "b", "", 1 ), Range( 3, 9 ), 3 ) );
+	items.push_back( create_sequence( "", SequencePattern( "c.", ".dpx", 2 ), Range( 10, 20 ) ) );
+	return items;
+}
+
+BOOST_AUTO_TEST_CASE( plain_format_test )
+{
+	const vector<BrowseItem> items = sampleItems();
+	ostringstream expected;
+	for( size_t i = 0; i < items.size(); ++i )
+		expected << items[i] << '\n';
+	// a tiny buffer is flushed many times
+	BOOST_CHECK_EQUAL( writeItems( items, FORMAT_PLAIN, 1 ), expected.str() );
+	BOOST_CHECK_EQUAL( writeItems( items, FORMAT_PLAIN, 4096 ), expected.str() );
+}
+
+BOOST_AUTO_TEST_CASE( json_and_nul_format_test )
+{
+	vector<BrowseItem> items = sampleItems();
+	items.resize( 3 );
+	BOOST_CHECK_EQUAL( writeItems( items, FORMAT_JSON, 4096 ),
+		"{\"type\":\"FOLDER\",\"path\":\"/s/folder\"}\n"
+		"{\"type\":\"UNITFILE\",\"path\":\"/s/a \\\"quoted\\\" & file.txt\"}\n"
+		"{\"type\":\"SEQUENCE\",\"path\":\"/s/beauty.####.exr\",\"directory\":\"/s\",\"prefix\":\"beauty.\",\"suffix\":\".exr\","
+		"\"padding\":4,\"first\":1,\"last\":100,\"step\":1}\n" );
+	const string nul = writeItems( items, FORMAT_NUL, 4096 );
+	const char expected[] = "/s/folder\0/s/a \"quoted\" & file.txt\0/s/beauty.####.exr";
+	BOOST_CHECK_EQUAL( nul, string( expected, sizeof( expected ) ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()